@@ -0,0 +1,381 @@
+// Component microbenchmarks for the simulator's hot kernels
+//
+// Build and run: make microbench   (results in bin/microbench.csv)
+// Usage: microbench [-filter substr] [-ops N] [-reps R] [-seed S] [-o file]
+//
+// Kernels:
+//   check_hit      CACHE::check_hit on fully populated ITLB..LLC arrays,
+//                  half of the probes hit
+//   check_queue    PACKET_QUEUE::check_queue on full queues of 8..64
+//                  entries, half of the probes hit
+//   dram_schedule  MEMORY_CONTROLLER::schedule with 8..64 reads in the RQ;
+//                  the scheduled entry and its bank are released after each
+//                  call so every call sees the same queue
+//   pht_find       Bingo PatternHistoryTable::find, mix of PC+Address,
+//                  PC+Offset and missing keys
+//   bingo_vote     Bingo::vote among 1..8 footprints
+//   va_to_pa       translation of pages already in the page table, over
+//                  working sets of 1K and 64K pages
+//   perceptron     hashed perceptron predict + update on a synthetic branch
+//                  stream of 256 or 4K static branches
+//
+// All inputs are drawn from std::mt19937_64 with a fixed seed before timing
+// starts, so the checksum column is identical from run to run and only the
+// timings move. Each kernel runs one untimed pass, then -reps timed passes
+// of -ops operations; the min and median ns per operation are reported.
+//
+// CSV columns: kernel,variant,ops,reps,ns_per_op_min,ns_per_op_median,
+// checksum
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <getopt.h>
+#include <random>
+
+#include "ooo_cpu.h"
+#include "uncore.h"
+
+#include "branch/hashed_perceptron.bpred"
+#include "prefetcher/bingo_new.l1d_pref"
+
+#define NUM_PROBES 4096 // power of two, probes are reused round robin
+
+struct BENCH_OPTIONS {
+    string filter, output;
+    uint64_t ops, seed;
+    uint32_t reps;
+};
+
+BENCH_OPTIONS opts = {"", "microbench.csv", 1000000, 1, 5};
+ofstream csv;
+
+// runs body(ops) once untimed and then opts.reps times timed; body returns
+// a checksum that both defeats dead code elimination and pins the inputs
+template <typename F>
+void run_kernel(const string &kernel, const string &variant, uint64_t ops,
+                F body) {
+    if (!opts.filter.empty() &&
+        (kernel + "/" + variant).find(opts.filter) == string::npos)
+        return;
+
+    uint64_t checksum = body(ops);
+    vector<double> ns_per_op;
+    for (uint32_t r = 0; r < opts.reps; r++) {
+        auto start = chrono::steady_clock::now();
+        body(ops);
+        auto stop = chrono::steady_clock::now();
+        ns_per_op.push_back(
+            chrono::duration<double, nano>(stop - start).count() / ops);
+    }
+    sort(ns_per_op.begin(), ns_per_op.end());
+    double min = ns_per_op.front(), median = ns_per_op[ns_per_op.size() / 2];
+
+    cout << setw(14) << left << kernel << setw(12) << variant << right
+         << setw(10) << fixed << setprecision(2) << min << setw(10) << median
+         << " ns/op  checksum " << checksum << endl;
+    csv << kernel << "," << variant << "," << ops << "," << opts.reps << ","
+        << min << "," << median << "," << checksum << endl;
+}
+
+void bench_check_hit(CACHE &cache) {
+    mt19937_64 rng(opts.seed);
+    uint32_t set_bits = lg2(cache.NUM_SET);
+
+    for (uint32_t set = 0; set < cache.NUM_SET; set++)
+        for (uint32_t way = 0; way < cache.NUM_WAY; way++) {
+            BLOCK &b = cache.block[set][way];
+            b.valid = 1;
+            b.tag = b.address = ((rng() >> 20) << set_bits) | set;
+        }
+
+    vector<PACKET> probes(NUM_PROBES);
+    for (PACKET &p : probes) {
+        if (rng() & 1)
+            p.address =
+                cache.block[rng() % cache.NUM_SET][rng() % cache.NUM_WAY].tag;
+        else
+            p.address = rng() >> 20;
+    }
+
+    run_kernel("check_hit", cache.NAME, opts.ops, [&](uint64_t ops) {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < ops; i++)
+            sum += cache.check_hit(&probes[i & (NUM_PROBES - 1)]) + 1;
+        return sum;
+    });
+}
+
+void bench_check_queue(uint32_t size) {
+    mt19937_64 rng(opts.seed);
+    PACKET_QUEUE queue("L2C_RQ", size);
+    for (uint32_t i = 0; i < size; i++)
+        queue.entry[i].address = rng() >> 20;
+    queue.occupancy = size;
+
+    vector<PACKET> probes(NUM_PROBES);
+    for (PACKET &p : probes)
+        p.address = (rng() & 1) ? queue.entry[rng() % size].address
+                                : rng() >> 20;
+
+    run_kernel("check_queue", to_string(size), opts.ops, [&](uint64_t ops) {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < ops; i++)
+            sum += queue.check_queue(&probes[i & (NUM_PROBES - 1)]) + 1;
+        return sum;
+    });
+}
+
+void bench_dram_schedule(uint32_t occupancy) {
+    mt19937_64 rng(opts.seed);
+    MEMORY_CONTROLLER *dram = new MEMORY_CONTROLLER("BENCH_DRAM");
+    PACKET_QUEUE &rq = dram->RQ[0];
+    vector<uint64_t> arrival(rq.SIZE);
+
+    // reads spread over a handful of rows per bank so that both the open
+    // row pass and the oldest-first pass find candidates
+    const int row_shift = LOG2_DRAM_CHANNELS + LOG2_DRAM_RANKS +
+                          LOG2_DRAM_BANKS + LOG2_DRAM_COLUMNS;
+    for (uint32_t i = 0; i < occupancy; i++) {
+        PACKET &p = rq.entry[i];
+        p.address =
+            ((rng() % 4) << row_shift) | (rng() & ((1ULL << row_shift) - 1));
+        p.full_addr = p.address << LOG2_BLOCK_SIZE;
+        p.type = LOAD;
+        p.priority = 1;
+        p.event_cycle = arrival[i] = rng() % 1000;
+    }
+    rq.occupancy = occupancy;
+
+    run_kernel(
+        "dram_schedule", to_string(occupancy), opts.ops / 10,
+        [&](uint64_t ops) {
+            uint64_t sum = 0;
+            for (uint64_t i = 0; i < ops; i++) {
+                dram->schedule(&rq);
+                for (uint32_t r = 0; r < DRAM_RANKS; r++)
+                    for (uint32_t b = 0; b < DRAM_BANKS; b++) {
+                        BANK_REQUEST &bank = dram->bank_request[0][r][b];
+                        if (!bank.working)
+                            continue;
+                        sum += bank.request_index + 1;
+                        rq.entry[bank.request_index].scheduled = 0;
+                        rq.entry[bank.request_index].event_cycle =
+                            arrival[bank.request_index];
+                        bank.working = 0;
+                    }
+                dram->scheduled_reads[0] = 0;
+            }
+            return sum;
+        });
+
+    delete dram;
+}
+
+// random footprint with roughly a quarter of the blocks set
+vector<bool> random_pattern(mt19937_64 &rng, int len) {
+    vector<bool> pattern(len);
+    for (int i = 0; i < len; i++)
+        pattern[i] = (rng() & 3) == 0;
+    return pattern;
+}
+
+// geometry mirrors CACHE::l1d_prefetcher_initialize in bingo_new.l1d_pref
+const int BINGO_PATTERN_LEN = 2 * 1024 >> LOG2_BLOCK_SIZE;
+
+void bench_pht_find() {
+    mt19937_64 rng(opts.seed);
+    L1D_PREF::PatternHistoryTable pht(8 * 1024, BINGO_PATTERN_LEN, 5, 16, 16,
+                                      0, 16);
+
+    vector<uint64_t> pcs(256), blocks(16 * 1024);
+    vector<uint8_t> timeliness(BINGO_PATTERN_LEN, TIMELINESS_UNKNOWN);
+    for (uint64_t &pc : pcs)
+        pc = 0x400000 + (rng() & 0xffff) * 4;
+    for (uint64_t &block : blocks) {
+        block = rng() >> 28;
+        pht.insert(pcs[rng() % pcs.size()], block,
+                   random_pattern(rng, BINGO_PATTERN_LEN), timeliness);
+    }
+
+    // a quarter are inserted keys (PC+Address hits, if not evicted), half
+    // share a PC and offset with them (PC+Offset votes), the rest miss
+    vector<pair<uint64_t, uint64_t>> probes(NUM_PROBES);
+    for (auto &p : probes) {
+        uint64_t kind = rng() % 4;
+        p.first = pcs[rng() % pcs.size()];
+        p.second = blocks[rng() % blocks.size()];
+        if (kind == 1 || kind == 2)
+            p.second += BINGO_PATTERN_LEN * (1 + rng() % 1024);
+        else if (kind == 3)
+            p.first = 0x800000 + (rng() & 0xffff) * 4;
+    }
+
+    run_kernel("pht_find", "8K_16way", opts.ops / 10, [&](uint64_t ops) {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < ops; i++) {
+            auto &p = probes[i & (NUM_PROBES - 1)];
+            sum += pht.find(p.first, p.second).size();
+        }
+        return sum;
+    });
+}
+
+void bench_bingo_vote(int voters) {
+    mt19937_64 rng(opts.seed);
+    L1D_PREF::Bingo bingo(BINGO_PATTERN_LEN, 5, 16, 16, 64, 128, 8 * 1024, 16,
+                          128, 0);
+
+    vector<vector<vector<bool>>> ballots(NUM_PROBES / 16);
+    for (auto &ballot : ballots)
+        for (int v = 0; v < voters; v++)
+            ballot.push_back(random_pattern(rng, BINGO_PATTERN_LEN));
+
+    run_kernel("bingo_vote", to_string(voters), opts.ops / 10,
+               [&](uint64_t ops) {
+                   uint64_t sum = 0;
+                   for (uint64_t i = 0; i < ops; i++) {
+                       vector<int> res =
+                           bingo.vote(ballots[i % ballots.size()]);
+                       for (int level : res)
+                           sum += level;
+                   }
+                   return sum;
+               });
+}
+
+void bench_va_to_pa(uint64_t pages) {
+    mt19937_64 rng(opts.seed);
+    uint64_t base = 0x10000000ULL >> LOG2_PAGE_SIZE;
+
+    // populate the page table outside the timed region
+    for (uint64_t page = 0; page < pages; page++)
+        va_to_pa(0, 0, (base + page) << LOG2_PAGE_SIZE, base + page, 0);
+
+    vector<uint64_t> probes(NUM_PROBES);
+    for (uint64_t &va : probes)
+        va = ((base + rng() % pages) << LOG2_PAGE_SIZE) | (rng() & 0xfff);
+
+    run_kernel("va_to_pa", to_string(pages), opts.ops, [&](uint64_t ops) {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < ops; i++) {
+            uint64_t va = probes[i & (NUM_PROBES - 1)];
+            sum ^= va_to_pa(0, i, va, va >> LOG2_PAGE_SIZE, 0) + i;
+        }
+        return sum;
+    });
+
+    page_table.clear();
+    inverse_table.clear();
+    unique_cl[0].clear();
+    clock_vkeys.clear();
+    clock_hand = 0;
+    allocated_pages = 0;
+}
+
+void bench_perceptron(uint32_t branches) {
+    mt19937_64 rng(opts.seed);
+
+    // each static branch is either biased or follows a short periodic
+    // pattern, which the global history can learn
+    vector<uint64_t> ips(branches);
+    vector<uint32_t> bias(branches), period(branches);
+    for (uint32_t b = 0; b < branches; b++) {
+        ips[b] = 0x400000 + (rng() & 0xfffff) * 4;
+        bias[b] = rng() % 100;
+        period[b] = (rng() & 1) ? 2 + rng() % 7 : 0;
+    }
+
+    const uint32_t stream_len = 64 * 1024;
+    vector<pair<uint64_t, uint8_t>> stream(stream_len);
+    vector<uint32_t> visits(branches);
+    for (auto &s : stream) {
+        uint32_t b = rng() % branches;
+        s.first = ips[b];
+        s.second = period[b] ? (visits[b]++ % period[b]) == 0
+                             : (rng() % 100) < bias[b];
+    }
+
+    ooo_cpu[0].initialize_branch_predictor();
+    run_kernel("perceptron", to_string(branches), opts.ops, [&](uint64_t ops) {
+        uint64_t correct = 0;
+        for (uint64_t i = 0; i < ops; i++) {
+            auto &s = stream[i % stream_len];
+            correct += ooo_cpu[0].predict_branch(s.first) == s.second;
+            ooo_cpu[0].last_branch_result(s.first, s.second);
+        }
+        return correct;
+    });
+}
+
+int main(int argc, char **argv) {
+    while (1) {
+        static struct option long_options[] = {
+            {"filter", required_argument, 0, 'f'},
+            {"ops", required_argument, 0, 'n'},
+            {"reps", required_argument, 0, 'r'},
+            {"seed", required_argument, 0, 's'},
+            {"o", required_argument, 0, 'o'},
+            {0, 0, 0, 0}};
+        int option_index = 0;
+        int c = getopt_long_only(argc, argv, "", long_options, &option_index);
+        if (c == -1)
+            break;
+        switch (c) {
+        case 'f':
+            opts.filter = optarg;
+            break;
+        case 'n':
+            opts.ops = max(10ULL, strtoull(optarg, NULL, 0));
+            break;
+        case 'r':
+            opts.reps = max(1, atoi(optarg));
+            break;
+        case 's':
+            opts.seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'o':
+            opts.output = optarg;
+            break;
+        default:
+            cerr << "usage: " << argv[0]
+                 << " [-filter substr] [-ops N] [-reps R] [-seed S] [-o file]"
+                 << endl;
+            return 1;
+        }
+    }
+
+    csv.open(opts.output);
+    if (!csv) {
+        cerr << "cannot open " << opts.output << endl;
+        return 1;
+    }
+    csv << "kernel,variant,ops,reps,ns_per_op_min,ns_per_op_median,checksum"
+        << endl;
+    cout << "kernel        variant          min    median" << endl;
+
+    O3_CPU &cpu = ooo_cpu[0];
+    CACHE *caches[] = {&cpu.ITLB, &cpu.DTLB, &cpu.STLB, &cpu.L1I,
+                       &cpu.L1D,  &cpu.L2C,  &uncore.LLC};
+    for (CACHE *cache : caches)
+        bench_check_hit(*cache);
+
+    for (uint32_t size : {8, 16, 32, 64})
+        bench_check_queue(size);
+
+    for (uint32_t occupancy : {8, 32, 64})
+        bench_dram_schedule(occupancy);
+
+    bench_pht_find();
+    for (int voters : {1, 2, 4, 8})
+        bench_bingo_vote(voters);
+
+    for (uint64_t pages : {1024, 64 * 1024})
+        bench_va_to_pa(pages);
+
+    for (uint32_t branches : {256, 4096})
+        bench_perceptron(branches);
+
+    cout << "Results written to " << opts.output << endl;
+    return 0;
+}
@@ -0,0 +1,69 @@
+#!/bin/bash
+#
+# Offline simulator throughput benchmark.
+#
+# Builds one fixed ChampSim configuration, generates a fixed matrix of
+# synthetic traces (pattern x memory intensity, fixed seed) and reports the
+# simulated instructions per second and peak RSS of each run. Traces are
+# cached in bin/bench and only regenerated when missing.
+#
+# Usage: ./bench/run_bench.sh
+# Environment overrides:
+#   BENCH_CONFIG  build_champsim.sh arguments
+#                 (default: "bimodal next_line bingo_new bingo bingo lru 1")
+#   BENCH_WARMUP  warmup instructions    (default: 200000)
+#   BENCH_SIM     simulated instructions (default: 1000000)
+
+BENCH_CONFIG=${BENCH_CONFIG:-"bimodal next_line bingo_new bingo bingo lru 1"}
+BENCH_WARMUP=${BENCH_WARMUP:-200000}
+BENCH_SIM=${BENCH_SIM:-1000000}
+
+PATTERNS="stream stride random chase bingo"
+INTENSITIES="0.1 0.4"
+BENCH_DIR=bin/bench
+
+cd "$(dirname "$0")/.." || exit 1
+mkdir -p ${BENCH_DIR}
+
+# Build the generator and the simulator
+g++ -O2 -std=c++11 -Iinc -o ${BENCH_DIR}/trace_gen bench/trace_gen.cc || exit 1
+./build_champsim.sh ${BENCH_CONFIG} > ${BENCH_DIR}/build.log 2>&1 || {
+    echo "[ERROR] build failed, see ${BENCH_DIR}/build.log"
+    exit 1
+}
+BINARY=bin/$(echo ${BENCH_CONFIG} | awk '{print $1"-"$2"-"$3"-"$4"-"$5"-"$6"-"$7"core"}')
+
+# Traces hold enough instructions that the simulator never wraps around
+TRACE_INSTRUCTIONS=$((BENCH_WARMUP + BENCH_SIM + 1000000))
+
+RESULTS=${BENCH_DIR}/results.csv
+echo "pattern,intensity,instructions,seconds,kips,peak_rss_mb" > ${RESULTS}
+printf "%-8s %9s %12s %9s %9s %12s\n" pattern intensity instructions seconds KIPS peak_rss_MB
+
+for pattern in ${PATTERNS}; do
+    for intensity in ${INTENSITIES}; do
+        trace=${BENCH_DIR}/${pattern}-${intensity}-${TRACE_INSTRUCTIONS}.champsimtrace.xz
+        if [ ! -f ${trace} ]; then
+            ${BENCH_DIR}/trace_gen -pattern ${pattern} -intensity ${intensity} \
+                -instructions ${TRACE_INSTRUCTIONS} -seed 1 -o ${trace} || exit 1
+        fi
+
+        log=${BENCH_DIR}/${pattern}-${intensity}.txt
+        ./${BINARY} -warmup_instructions ${BENCH_WARMUP} \
+            -simulation_instructions ${BENCH_SIM} -hide_heartbeat \
+            -traces ${trace} > ${log} 2>&1
+
+        # Simulator throughput: N instructions in S sec  KIPS: K  Peak RSS: M MB
+        line=$(grep "^Simulator throughput" ${log})
+        if [ -z "${line}" ]; then
+            echo "[ERROR] ${pattern} ${intensity} did not finish, see ${log}"
+            continue
+        fi
+        set -- ${line}
+        printf "%-8s %9s %12s %9.2f %9.1f %12s\n" ${pattern} ${intensity} $3 $6 $9 ${12}
+        echo "${pattern},${intensity},$3,$6,$9,${12}" >> ${RESULTS}
+    done
+done
+
+echo ""
+echo "Results written to ${RESULTS}"
@@ -0,0 +1,226 @@
+// Synthetic ChampSim trace generator
+//
+// Build: g++ -O2 -std=c++11 -Iinc -o bin/trace_gen bench/trace_gen.cc
+// Usage: trace_gen -pattern <name> [-instructions N] [-intensity F]
+//                  [-footprint_mb M] [-seed S] [-o file[.xz|.gz]]
+//
+// Patterns:
+//   stream  sequential 8B accesses over the footprint, 1 in 4 is a store
+//   stride  four interleaved streams with a 320B stride
+//   random  uniformly random 8B accesses, 1 in 4 is a store
+//   chase   dependent loads following a random cyclic permutation of lines
+//   bingo   recurring spatial footprints: each trigger PC owns a fixed set
+//           of lines it touches whenever it lands on a new 4KB page
+//
+// -intensity is the fraction of instructions that access memory. The rest
+// are register-only ALU operations, plus one loop-closing conditional
+// branch every 16 instructions. Output is written raw unless the file name
+// ends in .xz or .gz, in which case it is piped through the compressor.
+
+#include <algorithm>
+#include <getopt.h>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "champsim.h"
+#include "instruction.h"
+
+#define LOG2_LINE 6
+#define LOG2_PAGE 12
+#define LINES_PER_PAGE (1 << (LOG2_PAGE - LOG2_LINE))
+#define LOOP_BODY 16
+#define CODE_BASE 0x400000ULL
+#define DATA_BASE 0x10000000ULL
+#define NUM_FOOTPRINTS 64
+#define REG_CHASE 14
+
+struct GENERATOR {
+    std::string pattern;
+    uint64_t footprint, position, chase_line;
+    double intensity;
+    std::mt19937_64 rng;
+    std::vector<uint32_t> next_line;           // chase permutation
+    std::vector<uint64_t> footprint_bits;      // bingo patterns
+    std::vector<uint32_t> pending;             // bingo lines left on page
+    uint64_t page, trigger;
+
+    GENERATOR(std::string p, uint64_t bytes, double i, uint64_t seed)
+        : pattern(p), footprint(bytes), position(0), chase_line(0),
+          intensity(i), rng(seed), page(0), trigger(0) {
+        uint64_t lines = footprint >> LOG2_LINE;
+        if (pattern == "chase") {
+            // Sattolo's algorithm gives a single cycle through every line
+            next_line.resize(lines);
+            for (uint64_t l = 0; l < lines; l++)
+                next_line[l] = l;
+            for (uint64_t l = lines - 1; l > 0; l--)
+                std::swap(next_line[l], next_line[rng() % l]);
+        } else if (pattern == "bingo") {
+            for (int f = 0; f < NUM_FOOTPRINTS; f++) {
+                uint64_t bits = 0;
+                int density = 4 + rng() % 24;
+                for (int b = 0; b < density; b++)
+                    bits |= 1ULL << (rng() % LINES_PER_PAGE);
+                footprint_bits.push_back(bits);
+            }
+        }
+    }
+
+    // returns the data address and whether it is a store; sets the ip
+    uint64_t next_access(uint64_t &ip, bool &store) {
+        store = false;
+        if (pattern == "stream") {
+            uint64_t a = DATA_BASE + position;
+            position = (position + 8) % footprint;
+            store = (rng() & 3) == 0;
+            ip = CODE_BASE + 0x1000;
+            return a;
+        }
+        if (pattern == "stride") {
+            uint64_t stream = position & 3,
+                     offset = ((position >> 2) * 320) % (footprint / 4);
+            position++;
+            ip = CODE_BASE + 0x1000 + stream * 4;
+            return DATA_BASE + stream * (footprint / 4) + offset;
+        }
+        if (pattern == "random") {
+            store = (rng() & 3) == 0;
+            ip = CODE_BASE + 0x1000 + (rng() & 7) * 4;
+            return DATA_BASE + ((rng() % footprint) & ~7ULL);
+        }
+        if (pattern == "chase") {
+            chase_line = next_line[chase_line];
+            ip = CODE_BASE + 0x1000;
+            return DATA_BASE + (chase_line << LOG2_LINE);
+        }
+
+        // bingo: finish the current page's footprint, then jump to a new page
+        if (pending.empty()) {
+            uint64_t pages = footprint >> LOG2_PAGE;
+            page = rng() % pages;
+            trigger = rng() % NUM_FOOTPRINTS;
+            for (int l = 0; l < LINES_PER_PAGE; l++)
+                if (footprint_bits[trigger] & (1ULL << l))
+                    pending.push_back(l);
+            // visit the footprint in a trigger-specific but fixed order
+            std::mt19937_64 order(trigger);
+            std::shuffle(pending.begin(), pending.end(), order);
+        }
+        uint32_t line = pending.back();
+        pending.pop_back();
+        ip = CODE_BASE + 0x1000 + trigger * 4;
+        return DATA_BASE + (page << LOG2_PAGE) + (line << LOG2_LINE) +
+               (rng() & 7) * 8;
+    }
+};
+
+int main(int argc, char **argv) {
+    std::string pattern = "stream", output;
+    uint64_t instructions = 10000000, footprint_mb = 64, seed = 1;
+    double intensity = 0.3;
+
+    static struct option long_options[] = {
+        {"pattern", required_argument, 0, 'p'},
+        {"instructions", required_argument, 0, 'n'},
+        {"intensity", required_argument, 0, 'm'},
+        {"footprint_mb", required_argument, 0, 'f'},
+        {"seed", required_argument, 0, 's'},
+        {"o", required_argument, 0, 'o'},
+        {0, 0, 0, 0}};
+    int c;
+    while ((c = getopt_long_only(argc, argv, "", long_options, NULL)) != -1) {
+        switch (c) {
+        case 'p':
+            pattern = optarg;
+            break;
+        case 'n':
+            instructions = atoll(optarg);
+            break;
+        case 'm':
+            intensity = atof(optarg);
+            break;
+        case 'f':
+            footprint_mb = atoll(optarg);
+            break;
+        case 's':
+            seed = atoll(optarg);
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        default:
+            return 1;
+        }
+    }
+    if (pattern != "stream" && pattern != "stride" && pattern != "random" &&
+        pattern != "chase" && pattern != "bingo") {
+        fprintf(stderr, "unknown pattern %s\n", pattern.c_str());
+        return 1;
+    }
+
+    FILE *out = stdout;
+    bool piped = false;
+    if (!output.empty()) {
+        std::string ext = output.substr(output.find_last_of('.') + 1);
+        if (ext == "xz" || ext == "gz") {
+            std::string cmd = (ext == "xz" ? "xz -1 -T0 -c > " : "gzip -c > ") +
+                              output;
+            out = popen(cmd.c_str(), "w");
+            piped = true;
+        } else
+            out = fopen(output.c_str(), "wb");
+        if (out == NULL) {
+            perror(output.c_str());
+            return 1;
+        }
+    }
+
+    GENERATOR gen(pattern, footprint_mb << 20, intensity, seed);
+    std::bernoulli_distribution is_memory(intensity);
+    std::mt19937_64 rng(seed + 1);
+
+    for (uint64_t i = 0; i < instructions; i++) {
+        input_instr instr;
+        uint32_t slot = i % LOOP_BODY;
+        instr.ip = CODE_BASE + slot * 4;
+
+        if (slot == LOOP_BODY - 1) {
+            // loop-closing conditional branch, taken most of the time
+            instr.is_branch = 1;
+            instr.branch_taken = (rng() % 16) != 0;
+            instr.destination_registers[0] = REG_INSTRUCTION_POINTER;
+            instr.source_registers[0] = REG_INSTRUCTION_POINTER;
+            instr.source_registers[1] = REG_FLAGS;
+        } else if (is_memory(rng)) {
+            uint64_t ip;
+            bool store;
+            uint64_t addr = gen.next_access(ip, store);
+            instr.ip = ip;
+            if (store) {
+                instr.destination_memory[0] = addr;
+                instr.source_registers[0] = 1 + slot % 8;
+            } else if (pattern == "chase") {
+                // each load's address depends on the previous one
+                instr.source_memory[0] = addr;
+                instr.source_registers[0] = REG_CHASE;
+                instr.destination_registers[0] = REG_CHASE;
+            } else {
+                instr.source_memory[0] = addr;
+                instr.destination_registers[0] = 1 + slot % 8;
+            }
+        } else {
+            instr.destination_registers[0] = 1 + slot % 8;
+            instr.source_registers[0] = 1 + (slot + 3) % 8;
+            instr.source_registers[1] = 1 + (slot + 5) % 8;
+        }
+
+        fwrite(&instr, sizeof(instr), 1, out);
+    }
+
+    if (piped)
+        pclose(out);
+    else if (out != stdout)
+        fclose(out);
+    return 0;
+}
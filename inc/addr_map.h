@@ -0,0 +1,117 @@
+#ifndef ADDR_MAP_H
+#define ADDR_MAP_H
+
+#include <stdint.h>
+
+#include <vector>
+
+// Open-addressed hash map from a page or block number to a 64-bit value
+//
+// Used for the page tables and the footprint bitmaps in va_to_pa, which
+// every memory operand goes through. Linear probing over one flat array
+// keeps a lookup to one or two cache lines, where std::map walks a
+// pointer-linked tree of ~48-byte nodes. Deletion shifts later entries of
+// the probe run back, so no tombstones build up. UINT64_MAX marks an empty
+// slot and cannot be used as a key.
+
+#define ADDR_MAP_EMPTY UINT64_MAX
+
+class ADDR_MAP {
+  public:
+    struct ENTRY {
+        uint64_t key, value;
+    };
+
+    ADDR_MAP() : count(0) { resize(1024); }
+
+    uint64_t size() const { return count; }
+
+    // pointer to the value of key, NULL if absent
+    uint64_t *find(uint64_t key) {
+        for (uint64_t i = slot(key);; i = (i + 1) & mask) {
+            if (table[i].key == key)
+                return &table[i].value;
+            if (table[i].key == ADDR_MAP_EMPTY)
+                return NULL;
+        }
+    }
+
+    // value of key, inserted as 0 if absent
+    uint64_t &operator[](uint64_t key) {
+        uint64_t i = slot(key);
+        for (; table[i].key != ADDR_MAP_EMPTY; i = (i + 1) & mask)
+            if (table[i].key == key)
+                return table[i].value;
+
+        if (2 * (count + 1) > table.size()) { // keep the load under 1/2
+            resize(2 * table.size());
+            return (*this)[key];
+        }
+        table[i].key = key;
+        table[i].value = 0;
+        count++;
+        return table[i].value;
+    }
+
+    void erase(uint64_t key) {
+        uint64_t i = slot(key);
+        while (table[i].key != key) {
+            if (table[i].key == ADDR_MAP_EMPTY)
+                return;
+            i = (i + 1) & mask;
+        }
+
+        // move back any later entry whose home slot does not lie in
+        // (i, j], so every entry stays reachable from its home slot
+        for (uint64_t j = (i + 1) & mask; table[j].key != ADDR_MAP_EMPTY;
+             j = (j + 1) & mask) {
+            uint64_t home = slot(table[j].key);
+            if (((j - home) & mask) >= ((j - i) & mask)) {
+                table[i] = table[j];
+                i = j;
+            }
+        }
+        table[i].key = ADDR_MAP_EMPTY;
+        count--;
+    }
+
+    // calls f(key, value) for every entry, in no particular order
+    template <class F> void for_each(F f) {
+        for (ENTRY &e : table)
+            if (e.key != ADDR_MAP_EMPTY)
+                f(e.key, e.value);
+    }
+
+    void clear() {
+        table.clear();
+        count = 0;
+        resize(1024);
+    }
+
+  private:
+    std::vector<ENTRY> table;
+    uint64_t mask, count;
+    uint32_t shift;
+
+    uint64_t slot(uint64_t key) const {
+        // Fibonacci hashing spreads the dense low bits of page numbers
+        return (key * 0x9e3779b97f4a7c15ULL) >> shift;
+    }
+
+    void resize(uint64_t capacity) {
+        std::vector<ENTRY> old;
+        old.swap(table);
+        table.assign(capacity, ENTRY{ADDR_MAP_EMPTY, 0});
+        mask = capacity - 1;
+        shift = 64 - __builtin_ctzll(capacity);
+        for (ENTRY &e : old)
+            if (e.key != ADDR_MAP_EMPTY) {
+                uint64_t i = slot(e.key);
+                while (table[i].key != ADDR_MAP_EMPTY)
+                    i = (i + 1) & mask;
+                table[i] = e;
+            }
+    }
+};
+
+#endif
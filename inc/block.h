@@ -23,6 +23,11 @@ class BLOCK {
     // so we will set it to (uint64_t)(-1).
     uint64_t cycle_prefetched;
 
+    // priority the prefetch carried when it filled this block, and the
+    // cycles it was parked on the L1D prefetch wheel before issue
+    uint8_t pf_priority;
+    uint64_t pf_parked;
+
     BLOCK() {
         valid = 0;
         prefetch = 0;
@@ -44,6 +49,8 @@ class BLOCK {
         lru = 0;
 
         cycle_prefetched = 0;
+        pf_priority = 0;
+        pf_parked = 0;
     };
 };
 
@@ -84,6 +91,15 @@ class PACKET {
     // prefetch in order to report timeliness
     bool was_merged_with_prefetch_packet;
     uint64_t cycle_of_merge;
+    uint8_t merged_prefetch_priority;
+
+    // cycles a prefetch spent parked on the L1D prefetch wheel
+    uint64_t pf_parked;
+
+    // DRAM controller timestamps: arrival at the RQ, the last time the
+    // request was handed to a bank, and the last demotion to the lower
+    // priority queue (0 once the request has left that queue)
+    uint64_t dram_enqueue_cycle, dram_schedule_cycle, dram_demote_cycle;
 
     // Priority
     // 1 - Highest priority, treated as a LOAD by the DRAM Controller
@@ -93,6 +109,11 @@ class PACKET {
     // request. In the latter case a NACK is delivered to the LLC.
     uint8_t priority;
 
+    // set when the prefetcher chose the priority itself (the plain
+    // prefetch_line() marks every prefetch priority 1), and when it predicts
+    // the prefetch will arrive after its demand
+    uint8_t pf_rated, pf_late;
+
     PACKET() {
         instruction = 0;
         is_data = 1;
@@ -140,9 +161,18 @@ class PACKET {
 
         was_merged_with_prefetch_packet = false;
         cycle_of_merge = 0;
+        merged_prefetch_priority = 0;
+
+        pf_parked = 0;
+
+        dram_enqueue_cycle = 0;
+        dram_schedule_cycle = 0;
+        dram_demote_cycle = 0;
 
         // By default, a packet has the highest priority
         priority = 1;
+        pf_rated = 0;
+        pf_late = 0;
     };
 };
 
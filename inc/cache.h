@@ -1,7 +1,11 @@
 #ifndef CACHE_H
 #define CACHE_H
 
+#include <deque>
+
+#include "histogram.h"
 #include "memory_class.h"
+#include "profiler.h"
 
 // PAGE
 extern uint32_t PAGE_TABLE_LATENCY, SWAP_LATENCY;
@@ -80,6 +84,88 @@ extern uint32_t PAGE_TABLE_LATENCY, SWAP_LATENCY;
 
 extern int l1d_prefetch_hit_at[4];
 
+// set while O3_CPU::functional_warm() runs; prefetch_line() then hands
+// requests to queue_warm_prefetch() instead of the PQ
+extern uint8_t functional_warming;
+
+// per-priority prefetch accounting, CACHE::pf_class_stats[PF_CLASS_*][p]
+// with p the PACKET::priority the prefetch had at that point
+#define PF_CLASS_ISSUED 0   // accepted by prefetch_line
+#define PF_CLASS_MERGED 1   // merged into an in-flight MSHR entry
+#define PF_CLASS_NACKED 2   // MSHR entry dropped by nack_request
+#define PF_CLASS_PROMOTED 3 // priority raised by a demand or prefetch
+#define PF_CLASS_FILLED 4   // filled as a prefetch
+#define PF_CLASS_USEFUL 5   // first demand hit on the filled block
+#define PF_CLASS_LATE 6     // a demand merged into it while in flight
+#define PF_CLASS_USELESS 7  // evicted without a demand hit
+#define PF_CLASS_DROPPED 8  // pushed out of a full L1D PQ and overflow buffer
+#define PF_CLASS_REJECTED 9 // refused or dropped over its MSHR quota
+#define NUM_PF_CLASS_STATS 10
+
+struct WARM_PREFETCH {
+    uint64_t ip, full_addr;
+    int fill_level;
+};
+
+// NACK retry buffer (-nack_retry <cycles>)
+//
+// The LLC keeps the prefetches DRAM NACKed and hands them back to the
+// cache that issued them once the channel's read queue drains below
+// NACK_RETRY_WATERMARK and the memory pressure level is under 2, at
+// priority 2 so they are not NACKed again. A prefetch is only worth
+// retrying while it can still arrive before its demand, so each entry
+// expires after the median fill-to-use time of priority-3 prefetches at its
+// origin level, or after the knob's cycles until that level has
+// NACK_RETRY_MIN_SAMPLES uses recorded.
+#define NACK_RETRY_SIZE 64
+#define NACK_RETRY_WATERMARK 4
+#define NACK_RETRY_MIN_SAMPLES 64
+
+struct NACK_RETRY_ENTRY {
+    uint64_t address, full_addr, ip, deadline;
+    uint32_t cpu, pf_metadata;
+    int fill_level, pf_origin_level;
+};
+
+// Just-in-time prefetch issue (-jit_prefetch <cycles>)
+//
+// Priority-3 prefetches are the ones expected to sit in the cache long
+// before their use. The L1D parks them on a timing wheel of PF_WHEEL_SLOTS
+// slots of 2^PF_WHEEL_GRAIN_LOG2 cycles and puts them in its PQ once their
+// delay has passed, at priority 2. The delay is the median lead of such
+// prefetches, fill to first use plus any cycles parked, less the knob's
+// cycles so they still arrive ahead of the demand. Nothing is parked until
+// PF_WHEEL_MIN_SAMPLES leads are known, or when PF_WHEEL_SIZE prefetches
+// are already waiting.
+#define PF_WHEEL_SLOTS 256
+#define PF_WHEEL_GRAIN_LOG2 6
+#define PF_WHEEL_SIZE 64
+#define PF_WHEEL_MIN_SAMPLES 64
+
+// The L1D serves its PQ by priority, then age, rather than in FIFO order.
+// A prefetch arriving at a full PQ takes the slot of its lowest-priority,
+// youngest entry if it outranks it, and is refused otherwise, as before.
+// The displaced entry waits in an overflow buffer of PQ_OVERFLOW_SIZE
+// entries and moves back as soon as the PQ has room; a full buffer drops
+// its own lowest-priority, youngest entry first.
+#define PQ_OVERFLOW_SIZE 8
+
+// MSHR quotas by request class (-mshr_quota [L1D:|L2C:|LLC:]<p1>,<p2>,<p3>)
+//
+// mshr_quota[p] caps the MSHR entries that prefetches of priority p or
+// lower may hold together, so mshr_quota[1] leaves the rest to demands. A
+// prefetch over its quota is refused by prefetch_line, or dropped from the
+// PQ, NACKing the upper-level MSHR entries waiting for it. One of priority
+// 1 may carry a demand merged above, so it waits in the PQ instead. MSHR
+// occupancy by class is sampled every MSHR_OCCUPANCY_SAMPLE cycles.
+#define MSHR_OCCUPANCY_SAMPLE 64
+
+struct PF_WHEEL_ENTRY {
+    uint64_t ip, full_addr, parked_cycle;
+    uint32_t pf_metadata;
+    int fill_level;
+};
+
 class CACHE : public MEMORY {
   public:
     uint32_t cpu;
@@ -99,7 +185,7 @@ class CACHE : public MEMORY {
     // A sleazy hack to pass timeliness values to bingo
     int64_t timeliness_for_this_prefetch;
 
-    int pf_stats[4];
+    uint64_t pf_class_stats[NUM_PF_CLASS_STATS][4];
 
     // prefetch stats
     uint64_t pf_requested, pf_issued, pf_useful, pf_useless, pf_fill;
@@ -117,6 +203,31 @@ class CACHE : public MEMORY {
 
     uint64_t total_miss_latency;
 
+    // NACKed prefetches waiting for an idle channel, LLC only
+    std::deque<NACK_RETRY_ENTRY> nack_retry;
+    uint64_t nack_retry_buffered, nack_retry_reissued, nack_retry_expired,
+        nack_retry_overflow;
+
+    // MSHR quotas and sampled occupancy, indexed by class: 0 for demands,
+    // else the prefetch priority
+    uint32_t mshr_quota[4];
+    uint64_t mshr_occupancy[4], mshr_occupancy_samples;
+
+    // prefetches that found the PQ full, L1D only
+    std::vector<PACKET> pq_overflow;
+
+    // prefetches parked for just-in-time issue, L1D only; pf_wheel_tick is
+    // the next slot to release, in units of the slot width
+    std::vector<PF_WHEEL_ENTRY> pf_wheel[PF_WHEEL_SLOTS];
+    uint64_t pf_wheel_tick, pf_wheel_occupancy;
+    LOG_HISTOGRAM pf_wheel_lead_hist;
+    uint64_t pf_wheel_parked, pf_wheel_released, pf_wheel_dropped;
+
+    // latency distributions, indexed by PACKET::priority (0-3)
+    LOG_HISTOGRAM miss_latency_hist[NUM_TYPES][4],
+        pf_timeliness_hist[4], // fill to first use of a prefetched block
+        pf_late_hist[4];       // demand merged into an in-flight prefetch
+
     // constructor
     CACHE(string v1, uint32_t v2, int v3, uint32_t v4, uint32_t v5, uint32_t v6,
           uint32_t v7, uint32_t v8)
@@ -164,6 +275,27 @@ class CACHE : public MEMORY {
         pf_useful = 0;
         pf_useless = 0;
         pf_fill = 0;
+
+        for (uint32_t i = 0; i < NUM_PF_CLASS_STATS; i++)
+            for (uint32_t j = 0; j < 4; j++)
+                pf_class_stats[i][j] = 0;
+
+        nack_retry_buffered = 0;
+        nack_retry_reissued = 0;
+        nack_retry_expired = 0;
+        nack_retry_overflow = 0;
+
+        for (uint32_t i = 0; i < 4; i++) {
+            mshr_quota[i] = MSHR_SIZE;
+            mshr_occupancy[i] = 0;
+        }
+        mshr_occupancy_samples = 0;
+
+        pf_wheel_tick = 0;
+        pf_wheel_occupancy = 0;
+        pf_wheel_parked = 0;
+        pf_wheel_released = 0;
+        pf_wheel_dropped = 0;
     };
 
     // destructor
@@ -179,6 +311,14 @@ class CACHE : public MEMORY {
     void return_data(PACKET *packet), operate(),
         increment_WQ_FULL(uint64_t address);
 
+    // functional warming for sampled simulation (see smarts.h)
+    vector<WARM_PREFETCH> warm_prefetches;
+    // pf_origin_level: fill level of the cache that issued a PREFETCH
+    void warm_access(uint64_t address, uint64_t full_addr, uint64_t ip,
+                     uint8_t type, uint64_t data, int pf_origin_level = 0);
+    int queue_warm_prefetch(uint64_t ip, uint64_t base_addr, uint64_t pf_addr,
+                            int pf_fill_level);
+
     uint32_t get_occupancy(uint8_t queue_type, uint64_t address),
         get_size(uint8_t queue_type, uint64_t address);
 
@@ -191,9 +331,11 @@ class CACHE : public MEMORY {
                           int signature, int confidence,
                           uint32_t prefetch_metadata);
 
+    // late: the prefetcher predicts the block arrives after its demand, see
+    // pf_insertion.h
     int prefetch_line(uint64_t ip, uint64_t base_addr, uint64_t pf_addr,
                       int pf_fill_level, uint32_t prefetch_metadata,
-                      int priority);
+                      int priority, uint8_t late = 0);
 
     void handle_fill(), handle_writeback(), handle_read(), handle_prefetch();
 
@@ -206,9 +348,11 @@ class CACHE : public MEMORY {
         llc_update_replacement_state(uint32_t cpu, uint32_t set, uint32_t way,
                                      uint64_t full_addr, uint64_t ip,
                                      uint64_t victim_addr, uint32_t type,
-                                     uint8_t hit),
+                                     uint8_t hit, uint8_t prefetch,
+                                     uint8_t priority),
         lru_update(uint32_t set, uint32_t way),
         fill_cache(uint32_t set, uint32_t way, PACKET *packet),
+        evict_unused_prefetch(uint32_t set, uint32_t way),
         replacement_final_stats(), llc_replacement_final_stats(),
         // prefetcher_initialize(),
         l1d_prefetcher_initialize(), l2c_prefetcher_initialize(),
@@ -254,6 +398,23 @@ class CACHE : public MEMORY {
 
     // NACKing mechanism
     void nack_request(PACKET *packet);
+    void buffer_nacked_prefetch(PACKET *packet), retry_nacked_prefetches();
+    CACHE *nack_retry_origin(uint32_t cpu, int pf_origin_level);
+    // MSHR quotas
+    bool mshr_quota_allows(uint8_t priority), skip_pq_head();
+    void reject_prefetch(PACKET *packet), sample_mshr_occupancy();
+    // Priority-ordered L1D PQ
+    bool pq_has_room(uint8_t priority),
+        admits_prefetch(int pf_fill_level, uint8_t priority);
+    int add_pq_overflow(PACKET *packet);
+    void select_pq_head(), refill_pq();
+    // Just-in-time prefetch issue
+    uint64_t pf_wheel_delay();
+    void park_prefetch(uint64_t ip, uint64_t pf_addr, int pf_fill_level,
+                       uint32_t prefetch_metadata, uint64_t delay),
+        release_parked_prefetches(),
+        record_pf_lead(uint8_t pf_priority, uint64_t pf_parked,
+                       int64_t timeliness);
     // Relay a request for an increase in priority
     void increase_priority(PACKET *packet, uint8_t new_priority);
     // This one is also a NOP for caches
@@ -261,6 +422,18 @@ class CACHE : public MEMORY {
                                               uint8_t priority) {
         return false;
     }
+    // DRAM congestion, forwarded from the lower level
+    const MEMORY_PRESSURE &memory_pressure() {
+        static const MEMORY_PRESSURE idle;
+        return lower_level ? lower_level->memory_pressure() : idle;
+    }
+
+    // self-profiler regions; PROF_ITLB..PROF_LLC follow the IS_* order
+    uint8_t profile_region() { return PROF_ITLB + cache_type; }
+    uint8_t prefetcher_profile_region() {
+        return (cache_type >= IS_L1I) ? PROF_PF_L1I + (cache_type - IS_L1I)
+                                      : profile_region();
+    }
 };
 
 #endif
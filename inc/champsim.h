@@ -19,6 +19,8 @@
 #include <random>
 #include <string>
 
+#include "addr_map.h"
+
 // USEFUL MACROS
 //#define DEBUG_PRINT
 #define SANITY_CHECK
@@ -41,6 +43,8 @@
 #define DRAM_IO_FREQ 3200
 #define PAGE_SIZE 4096
 #define LOG2_PAGE_SIZE 12
+#define LOG2_HUGE_PAGE_SIZE 21
+#define PAGE_REFERENCED (1ULL << 63)
 
 // CACHE
 #define BLOCK_SIZE 64
@@ -90,9 +94,16 @@ extern uint32_t knob_low_bandwidth;
 extern uint64_t current_core_cycle[NUM_CPUS], stall_cycle[NUM_CPUS],
     last_drc_read_mode, last_drc_write_mode, drc_blocks;
 
-extern queue<uint64_t> page_queue;
-extern map<uint64_t, uint64_t> page_table, inverse_table, recent_page,
-    unique_cl[NUM_CPUS];
+// translations (virtual mapping key <-> physical frame) and, per CPU, a
+// bitmap of the cache lines touched in each virtual page. A mapping is one
+// 4KB page, or one 2MB region with -huge_pages; page table entries carry
+// PAGE_REFERENCED, which CLOCK replacement sweeps over clock_vkeys
+extern ADDR_MAP page_table, inverse_table, unique_cl[NUM_CPUS];
+extern vector<uint64_t> clock_vkeys;
+extern uint64_t clock_hand;
+extern uint8_t knob_huge_pages;
+extern uint64_t knob_nack_retry, knob_jit_prefetch;
+extern uint32_t LOG2_MAPPED_PAGE_SIZE;
 extern uint64_t previous_ppage, num_adjacent_page, num_cl[NUM_CPUS],
     allocated_pages, num_page[NUM_CPUS], minor_fault[NUM_CPUS],
     major_fault[NUM_CPUS];
@@ -3,6 +3,7 @@
 
 #include <queue>
 
+#include "histogram.h"
 #include "memory_class.h"
 
 // DRAM configuration
@@ -24,6 +25,14 @@ extern uint32_t DRAM_MTPS, DRAM_DBUS_RETURN_TIME;
 #define DRAM_WRITE_LOW_WM ((DRAM_WQ_SIZE * 3) >> 2)  // 6/8th
 #define MIN_DRAM_WRITES_PER_SWITCH (DRAM_WQ_SIZE * 1 / 4)
 
+// MEMORY_CONTROLLER::priority_stats rows
+#define DRAM_PRIORITY_DEMOTED 0
+#define DRAM_PRIORITY_NACKED 1
+#define DRAM_PRIORITY_PROMOTED 2
+#define DRAM_PRIORITY_ROW_HIT 3
+#define DRAM_PRIORITY_ROW_MISS 4
+#define NUM_DRAM_PRIORITY_STATS 5
+
 // DRAM
 class MEMORY_CONTROLLER : public MEMORY {
   public:
@@ -34,6 +43,9 @@ class MEMORY_CONTROLLER : public MEMORY {
         dbus_cycle_congested[DRAM_CHANNELS],
         dbus_congested[NUM_TYPES + 1][NUM_TYPES + 1];
     uint64_t bank_cycle_available[DRAM_CHANNELS][DRAM_RANKS][DRAM_BANKS];
+    // cycles the data bus spent transferring a block, used to derive bus
+    // utilization over an interval
+    uint64_t dbus_busy_cycles[DRAM_CHANNELS];
     uint8_t do_write, write_mode[DRAM_CHANNELS];
     uint32_t processed_writes, scheduled_reads[DRAM_CHANNELS],
         scheduled_writes[DRAM_CHANNELS];
@@ -48,19 +60,10 @@ class MEMORY_CONTROLLER : public MEMORY {
 
     // Though rare, it may happen that we want to promote a request which is in
     // the lower priority queue, but the main queue has no space. We take note
-    // of these indices below. We will try to promote these every cycle.
-    // Note that since the main queue is full, we will not be scheduling the
-    // secondary queue at all until the main queue empties below a certain
-    // threshold; hence, it is not possible that the entry at the corresponding
-    // index of the secondary queue is serviced before we promote it.
-    // Sidenote: After we merge a demand request with a prefetch, the MSHR entry
-    // no longer lists it as a prefetch. Hence, we should *not* recieve multiple
-    // promotion requests for the same index.
-    // All indices here are of the lower priority queue since main queue
-    // promotions are always feasible and will never be delayed. set just in
-    // case we have some corner cases with re-addition of indices in the retry
-    // loop
-    std::queue<pair<int, uint8_t>> pending_promotions[DRAM_CHANNELS];
+    // of these addresses below and try to promote them every cycle. The lower
+    // queue may still be served meanwhile, and its slots reused, so the retry
+    // looks the address up again and drops promotions whose request is gone.
+    std::queue<pair<uint64_t, uint8_t>> pending_promotions[DRAM_CHANNELS];
 
     // If the main queue occupancy is below this watermark, we schedule it and
     // the low priority queue in the ratio main_sched_ratio : low_sched_ratio.
@@ -68,6 +71,25 @@ class MEMORY_CONTROLLER : public MEMORY {
     uint32_t queue_scheduling_watermark;
     uint32_t main_sched_ratio, low_sched_ratio;
 
+    // Priority mechanism event counters, in total and per PACKET::priority
+    // of the request before the event; row buffer outcomes of prefetch reads
+    // by the priority they were served at, and of demand reads
+    uint64_t num_promotions, num_demotions, num_nacks;
+    uint64_t priority_stats[NUM_DRAM_PRIORITY_STATS][4];
+    uint64_t demand_row_hits, demand_row_misses;
+
+    // Congestion signal for the prefetchers, rebuilt by update_pressure()
+    // from the window accumulators below, and the windows spent per level
+    MEMORY_PRESSURE pressure;
+    uint64_t pressure_window_start, pressure_rq_occupancy, pressure_busy_start,
+        pressure_reads_start, pressure_nacks_start;
+    uint64_t pressure_windows[MEMORY_PRESSURE_LEVELS];
+
+    // read latency split, indexed by type and PACKET::priority
+    LOG_HISTOGRAM queueing_delay_hist[NUM_TYPES][4], // arrival to schedule
+        service_time_hist[NUM_TYPES][4],             // schedule to data
+        lower_rq_residency_hist[4]; // demotion to promotion/schedule
+
     // constructor
     MEMORY_CONTROLLER(string v1) : NAME(v1) {
         for (uint32_t i = 0; i < NUM_TYPES + 1; i++) {
@@ -77,9 +99,25 @@ class MEMORY_CONTROLLER : public MEMORY {
         }
         do_write = 0;
         processed_writes = 0;
+        num_promotions = 0;
+        num_demotions = 0;
+        num_nacks = 0;
+        for (uint32_t i = 0; i < NUM_DRAM_PRIORITY_STATS; i++)
+            for (uint32_t j = 0; j < 4; j++)
+                priority_stats[i][j] = 0;
+        demand_row_hits = 0;
+        demand_row_misses = 0;
+        pressure_window_start = 0;
+        pressure_rq_occupancy = 0;
+        pressure_busy_start = 0;
+        pressure_reads_start = 0;
+        pressure_nacks_start = 0;
+        for (uint32_t i = 0; i < MEMORY_PRESSURE_LEVELS; i++)
+            pressure_windows[i] = 0;
         for (uint32_t i = 0; i < DRAM_CHANNELS; i++) {
             dbus_cycle_available[i] = 0;
             dbus_cycle_congested[i] = 0;
+            dbus_busy_cycles[i] = 0;
             write_mode[i] = 0;
             scheduled_reads[i] = 0;
             scheduled_writes[i] = 0;
@@ -149,6 +187,9 @@ class MEMORY_CONTROLLER : public MEMORY {
                                     uint8_t new_priority, bool lower_prio_q);
     void retry_outstanding_promotions();
 
+    void update_pressure();
+    const MEMORY_PRESSURE &memory_pressure() { return pressure; }
+
     // nack_request is a NOP
     void nack_request(PACKET *packet) {}
 };
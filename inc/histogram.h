@@ -0,0 +1,75 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include "champsim.h"
+
+// Log2-bucketed latency histogram
+//
+// Bucket 0 holds zero, bucket k (k >= 1) holds values in [2^(k-1), 2^k).
+// Recording is a count-leading-zeros and an increment, so it is cheap enough
+// to sit on every fill. Percentiles are interpolated linearly inside the
+// bucket, which bounds their error by the bucket width.
+#define LOG_HIST_BUCKETS 65
+
+class LOG_HISTOGRAM {
+  public:
+    uint64_t bucket[LOG_HIST_BUCKETS], count, sum, max;
+
+    LOG_HISTOGRAM() { reset(); }
+
+    void reset() {
+        for (uint32_t i = 0; i < LOG_HIST_BUCKETS; i++)
+            bucket[i] = 0;
+        count = 0;
+        sum = 0;
+        max = 0;
+    }
+
+    void record(uint64_t value) {
+        bucket[value ? 64 - __builtin_clzll(value) : 0]++;
+        count++;
+        sum += value;
+        if (value > max)
+            max = value;
+    }
+
+    double mean() const { return count ? (1.0 * sum) / count : 0; }
+
+    // p in [0, 1]
+    uint64_t percentile(double p) const {
+        if (count == 0)
+            return 0;
+
+        uint64_t rank = (uint64_t)(p * (count - 1)) + 1, seen = 0;
+        for (uint32_t i = 0; i < LOG_HIST_BUCKETS; i++) {
+            if (seen + bucket[i] < rank) {
+                seen += bucket[i];
+                continue;
+            }
+            if (i == 0)
+                return 0;
+
+            uint64_t low = 1ULL << (i - 1),
+                     width = (i == 64) ? (UINT64_MAX - low) : low;
+            uint64_t value = low + (uint64_t)((1.0 * (rank - seen - 1) /
+                                               bucket[i]) *
+                                              width);
+            return value < max ? value : max;
+        }
+        return max;
+    }
+
+    // one line summary, skipped when nothing was recorded
+    void print(const string &label) const {
+        if (count == 0)
+            return;
+        cout << label << " COUNT: " << setw(10) << count
+             << "  MEAN: " << setw(8) << (uint64_t)mean()
+             << "  P50: " << setw(8) << percentile(0.50)
+             << "  P90: " << setw(8) << percentile(0.90)
+             << "  P99: " << setw(8) << percentile(0.99)
+             << "  MAX: " << setw(8) << max << endl;
+    }
+};
+
+#endif
@@ -105,8 +105,7 @@ class ooo_model_instr {
         branch_prediction_made, translated, data_translated,
         source_added[NUM_INSTR_SOURCES],
         destination_added[NUM_INSTR_DESTINATIONS_SPARC], is_producer,
-        is_consumer, reg_RAW_producer, reg_ready, mem_ready, asid[2],
-        reg_RAW_checked[NUM_INSTR_SOURCES];
+        is_consumer, reg_RAW_producer, reg_ready, mem_ready, asid[2];
 
     uint8_t branch_type;
     uint64_t branch_target;
@@ -123,18 +122,19 @@ class ooo_model_instr {
 
     uint8_t source_registers[NUM_INSTR_SOURCES]; // input registers
 
-    // these are instruction ids of other instructions in the window
-    // int64_t registers_instrs_i_depend_on[NUM_INSTR_SOURCES];
-    // these are indices of instructions in the window that depend on me
-    // uint8_t registers_instrs_depend_on_me[ROB_SIZE],
-    // registers_index_depend_on_me[ROB_SIZE][NUM_INSTR_SOURCES];
-    fastset registers_instrs_depend_on_me,
-        registers_index_depend_on_me[NUM_INSTR_SOURCES];
+    // source operands in the window that read my destination registers, as a
+    // list threaded through the consumers: a link is ROB index *
+    // NUM_INSTR_SOURCES + source index, and UINT32_MAX ends the list
+    uint32_t reg_consumer_head, reg_consumer_tail,
+        next_reg_consumer[NUM_INSTR_SOURCES];
 
     // memory addresses that may cause dependencies between instructions
     uint64_t instruction_pa, data_pa, virtual_address, physical_address;
     uint64_t destination_memory[NUM_INSTR_DESTINATIONS_SPARC]; // output memory
     uint64_t source_memory[NUM_INSTR_SOURCES];                 // input memory
+    // next older store to the same address in the ROB, as ROB index *
+    // NUM_INSTR_DESTINATIONS_SPARC + destination index (see store_map)
+    uint32_t prev_store[NUM_INSTR_DESTINATIONS_SPARC];
     // int source_memory_outstanding[NUM_INSTR_SOURCES];  // a value of 2 here
     // means the load hasn't been issued yet, 1 means it has been issued, but
     // not returned yet, and 0 means it has returned
@@ -194,6 +194,8 @@ class ooo_model_instr {
         num_reg_ops = 0;
         num_mem_ops = 0;
         num_reg_dependent = 0;
+        reg_consumer_head = UINT32_MAX;
+        reg_consumer_tail = UINT32_MAX;
 
         for (uint32_t i = 0; i < NUM_INSTR_SOURCES; i++) {
             source_registers[i] = 0;
@@ -201,7 +203,7 @@ class ooo_model_instr {
             source_virtual_address[i] = 0;
             source_added[i] = 0;
             lq_index[i] = UINT32_MAX;
-            reg_RAW_checked[i] = 0;
+            next_reg_consumer[i] = UINT32_MAX;
         }
 
         for (uint32_t i = 0; i < NUM_INSTR_DESTINATIONS_SPARC; i++) {
@@ -211,15 +213,12 @@ class ooo_model_instr {
             destination_added[i] = 0;
             sq_index[i] = UINT32_MAX;
             forwarding_index[i] = 0;
+            prev_store[i] = UINT32_MAX;
         }
 
 #if 0
         for (uint32_t i=0; i<ROB_SIZE; i++) {
-            registers_instrs_depend_on_me[i] = 0;
             memory_instrs_depend_on_me[i] = 0;
-
-            for (uint32_t j=0; j<NUM_INSTR_SOURCES; j++)
-                registers_index_depend_on_me[i][j] = 0;
         }
 #endif
     };
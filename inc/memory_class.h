@@ -17,6 +17,31 @@ extern uint32_t tRP, // Row Precharge (RP) latency
 
 extern uint64_t l2pf_access;
 
+// DRAM congestion as seen by the prefetchers. The memory controller
+// refreshes it every MEMORY_PRESSURE_WINDOW cycles and each cache returns
+// the one of its lower level, so a prefetcher at any level reads the same
+// signal through memory_pressure().
+#define MEMORY_PRESSURE_WINDOW 1024
+#define MEMORY_PRESSURE_LEVELS 4
+
+class MEMORY_PRESSURE {
+  public:
+    float rq_fill, // mean read queue occupancy over size
+        bus_util,  // fraction of cycles the data buses were busy
+        nack_rate; // NACKs per read that reached the controller
+    uint8_t level; // 0 (idle) to MEMORY_PRESSURE_LEVELS - 1 (saturated)
+
+    MEMORY_PRESSURE() : rq_fill(0), bus_util(0), nack_rate(0), level(0) {}
+
+    // a prefetch degree or lookahead depth cut down by the level: by a
+    // quarter per level with four levels, but never below 1
+    uint32_t scale(uint32_t n) const {
+        uint32_t scaled =
+            n * (MEMORY_PRESSURE_LEVELS - level) / MEMORY_PRESSURE_LEVELS;
+        return (scaled || n == 0) ? scaled : 1;
+    }
+};
+
 class MEMORY {
   public:
     // memory interface
@@ -44,6 +69,7 @@ class MEMORY {
     virtual bool check_availability_for_priority_read(uint64_t address,
                                                       uint8_t priority) = 0;
     virtual void nack_request(PACKET *packet) = 0;
+    virtual const MEMORY_PRESSURE &memory_pressure() = 0;
 
     // stats
     uint64_t ACCESS[NUM_TYPES], HIT[NUM_TYPES], MISS[NUM_TYPES],
@@ -20,6 +20,7 @@ using namespace std;
 #define SQ_WIDTH 2
 #define RETIRE_WIDTH 4
 #define SCHEDULER_SIZE 128
+#define NUM_ARCH_REGISTERS 256 // register numbers in traces are 8 bits
 #define BRANCH_MISPREDICT_PENALTY 1
 //#define SCHEDULING_LATENCY 0
 //#define EXEC_LATENCY 0
@@ -38,6 +39,7 @@ class O3_CPU {
     FILE *trace_file;
     char trace_string[1024];
     char gunzip_command[1024];
+    uint8_t trace_shm; // trace_file reads a trace_server ring
 
     // instruction
     input_instr next_instr;
@@ -48,6 +50,9 @@ class O3_CPU {
         finish_sim_instr, warmup_instructions, simulation_instructions,
         instrs_to_read_this_cycle, instrs_to_fetch_this_cycle,
         next_print_instruction, num_retired;
+    // instructions consumed by functional_warm(), never timed nor counted in
+    // num_retired; begin_sim_position is trace_position() at warmup end
+    uint64_t num_functional, begin_sim_position;
     uint32_t inflight_reg_executions, inflight_mem_executions, num_searched;
     uint32_t next_ITLB_fetch;
 
@@ -61,6 +66,18 @@ class O3_CPU {
     // instructions
     uint64_t STA[STA_SIZE], STA_head, STA_tail;
 
+    // youngest store in the ROB to each virtual address, linked to the older
+    // ones through ooo_model_instr::prev_store
+    ADDR_MAP store_map;
+
+    // rename table: ROB index of the youngest scheduled writer of each
+    // architectural register still in the window, ROB_SIZE if none
+    uint32_t rename_rob_index[NUM_ARCH_REGISTERS];
+
+    // memory instructions with all registers ready that still wait for their
+    // LSQ entries, keyed by instr_id so they are visited in program order
+    std::map<uint64_t, uint32_t> ready_memory;
+
     // Ready-To-Execute
     uint32_t RTE0[ROB_SIZE], RTE0_head, RTE0_tail, RTE1[ROB_SIZE], RTE1_head,
         RTE1_tail;
@@ -108,6 +125,7 @@ class O3_CPU {
 
         // trace
         trace_file = NULL;
+        trace_shm = 0;
 
         // instruction
         instr_unique_id = 0;
@@ -125,6 +143,8 @@ class O3_CPU {
 
         next_print_instruction = STAT_PRINTING_PERIOD;
         num_retired = 0;
+        num_functional = 0;
+        begin_sim_position = 0;
 
         inflight_reg_executions = 0;
         inflight_mem_executions = 0;
@@ -148,6 +168,9 @@ class O3_CPU {
         STA_head = 0;
         STA_tail = 0;
 
+        for (uint32_t i = 0; i < NUM_ARCH_REGISTERS; i++)
+            rename_rob_index[i] = ROB_SIZE;
+
         for (uint32_t i = 0; i < ROB_SIZE; i++) {
             RTE0[i] = ROB_SIZE;
             RTE1[i] = ROB_SIZE;
@@ -197,6 +220,13 @@ class O3_CPU {
         complete_data_fetch(PACKET_QUEUE *queue, uint8_t is_it_tlb);
 
     void initialize_core();
+    void reopen_trace();
+    uint64_t skip_trace(uint64_t instructions);
+    uint64_t functional_warm(uint64_t instructions);
+
+    // instructions consumed from the trace, timed or functionally warmed
+    uint64_t trace_position() const { return num_retired + num_functional; }
+    void warm_data_access(ooo_model_instr &instr, uint64_t va, uint8_t type);
     void add_load_queue(uint32_t rob_index, uint32_t data_index),
         add_store_queue(uint32_t rob_index, uint32_t data_index),
         execute_store(uint32_t rob_index, uint32_t sq_index,
@@ -0,0 +1,92 @@
+#ifndef PF_EVENT_LOG_H
+#define PF_EVENT_LOG_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "champsim.h"
+
+// Prefetch lifecycle event log
+//
+// When enabled with -pf_event_log, every step a prefetch takes through the
+// hierarchy is appended as a fixed-size PF_EVENT to a buffer owned by the
+// calling thread. Full buffers are handed to a background writer, so the
+// simulator only pays for a branch when the log is off and a 32-byte store
+// when it is on. scripts/pf_timeline.cc rebuilds per-prefetch timelines from
+// the file.
+
+#define PF_EVENT_FILE_MAGIC 0x474f4c544e564550ULL // "PEVNTLOG"
+#define PF_EVENT_FILE_VERSION 2
+#define PF_EVENT_BUFFER_SIZE 65536
+
+// event types
+#define PF_EVENT_ISSUE 0        // prefetch_line accepted the request
+#define PF_EVENT_ENQUEUE 1      // request entered a level's RQ/PQ
+#define PF_EVENT_DEMOTE 2       // DRAM moved it to LOWER_PRIORITY_RQ
+#define PF_EVENT_NACK 3         // nack_request dropped the MSHR entry
+#define PF_EVENT_PROMOTE 4      // increase_priority raised its priority
+#define PF_EVENT_FILL 5         // the block was filled as a prefetch
+#define PF_EVENT_USE 6          // first demand hit on the prefetched block
+#define PF_EVENT_EVICT_UNUSED 7 // evicted without a demand hit
+#define NUM_PF_EVENTS 8
+
+// levels reuse the CACHE::cache_type values, DRAM goes last
+#define PF_EVENT_LEVEL_DRAM 7
+
+struct PF_EVENT {
+    uint64_t cycle, address; // address is the block address
+    int64_t aux;             // event specific, see pf_event_log.cc hooks
+    uint8_t type, level, cpu, priority;
+};
+
+struct PF_EVENT_FILE_HEADER {
+    uint64_t magic;
+    uint32_t version, event_size;
+};
+
+struct PF_EVENT_BUFFER {
+    PF_EVENT event[PF_EVENT_BUFFER_SIZE];
+    uint32_t count;
+
+    PF_EVENT_BUFFER() : count(0) {}
+};
+
+class PF_EVENT_LOG {
+  public:
+    uint8_t enabled;
+
+    PF_EVENT_LOG() : enabled(0), file(NULL), stop(0), events_written(0) {}
+
+    void open(const char *path);
+    void close();
+
+    void record(uint8_t type, uint8_t level, uint32_t cpu, uint64_t address,
+                uint8_t priority, int64_t aux) {
+        if (!enabled)
+            return;
+        append(type, level, cpu, address, priority, aux);
+    }
+
+  private:
+    FILE *file;
+    uint8_t stop;
+    uint64_t events_written;
+
+    std::mutex lock;
+    std::condition_variable has_buffers;
+    std::thread writer;
+    std::deque<PF_EVENT_BUFFER *> full, spare;
+    std::vector<PF_EVENT_BUFFER *> owned; // every thread's current buffer
+
+    void append(uint8_t type, uint8_t level, uint32_t cpu, uint64_t address,
+                uint8_t priority, int64_t aux);
+    PF_EVENT_BUFFER *swap_buffer(PF_EVENT_BUFFER *buffer);
+    void writer_loop();
+};
+
+extern PF_EVENT_LOG pf_event_log;
+
+#endif
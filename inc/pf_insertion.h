@@ -0,0 +1,32 @@
+#ifndef PF_INSERTION_H
+#define PF_INSERTION_H
+
+#include "block.h"
+
+// Priority a prefetch fill is inserted with by the LLC replacement policies.
+// Only a priority the prefetcher chose counts: untagged prefetches (the plain
+// prefetch_line() marks every one priority 1) get the middle class, and a
+// prefetch predicted to arrive after its demand gets the distant class, since
+// the demand has already used it.
+inline uint8_t pf_insertion_priority(const PACKET &packet) {
+    if (!packet.pf_rated)
+        return 2;
+    if (packet.pf_late)
+        return 3;
+    return packet.priority;
+}
+
+// Insertion RRPV for that priority: 1 is wanted soon and goes near, 3 is far
+// ahead of its use or late and goes distant, everything else goes to
+// max_rrpv - 1 like an SRRIP demand fill. A prefetch that hits a line shows
+// no reuse, so the policies never promote on it past this position; they
+// only move the line up to where the prefetch would have inserted it.
+inline uint32_t prefetch_rrpv(uint8_t priority, uint32_t max_rrpv) {
+    if (priority == 1)
+        return max_rrpv - 2;
+    if (priority == 3)
+        return max_rrpv;
+    return max_rrpv - 1;
+}
+
+#endif
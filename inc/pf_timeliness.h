@@ -0,0 +1,161 @@
+#ifndef PF_TIMELINESS_H
+#define PF_TIMELINESS_H
+
+#include <vector>
+
+#include "champsim.h"
+
+// Prefetch timeliness tracker
+//
+// A cache reports the timeliness of each prefetched block through
+// CACHE::report_timeliness_function: the cycles from fill to the first
+// demand hit, negative when a demand caught the prefetch in flight, and
+// 1000000 when the block was evicted unused. The tracker turns that value
+// into a PACKET::priority with three per-level thresholds and remembers it
+// in a direct-mapped table of block addresses, so the next prefetch of the
+// block goes out at that priority:
+//   below timely  -> 1, needed soon
+//   below slack   -> 2
+//   below useless -> 3, far ahead of its use
+//   otherwise     -> 0, do not prefetch
+// A block prefetched into the L2C waits for an L1D miss before its first
+// use, one in the LLC for an L2C miss as well, so the thresholds double per
+// level from the L1D ones. A block is only measured when it is prefetched,
+// so every PF_TIMELINESS_PROBE_PERIOD-th lookup that finds priority 0 goes
+// out at 3 instead; otherwise the block could never be rated again.
+//
+// Prefetchers that rate their own candidates (SPP, KPCP, IPCP) start from a
+// priority derived from that confidence and let adjust() move it one class
+// by the measured timeliness of the block.
+
+#define PF_TIMELINESS_ENTRIES 4096
+#define PF_TIMELINESS_PROBE_PERIOD 8
+
+// L1D thresholds, in cycles
+#define PF_TIMELY_L1D 600
+#define PF_SLACK_L1D 2000
+#define PF_USELESS_L1D 14000
+
+// priority of a prefetch from its confidence: 1 at or above fill (the
+// confidence that would fill the closer cache), 2 in the upper half of
+// [issue, fill), 3 below that
+inline uint8_t pf_confidence_priority(int confidence, int fill, int issue) {
+    if (confidence >= fill)
+        return 1;
+    if (confidence >= (fill + issue) / 2)
+        return 2;
+    return 3;
+}
+
+// priority of an IPCP prefetch from the class of its IP (0 none, 1 stream,
+// 2 constant stride, 3 complex stride, 4 next line), shared by the L1D and
+// L2C halves: streams and constant strides go out at 1, complex strides at
+// 2 and next-line guesses at 3
+inline uint8_t pf_ipcp_class_priority(uint16_t type) {
+    static const uint8_t class_priority[5] = {3, 1, 1, 2, 3};
+    return class_priority[type];
+}
+
+class PF_TIMELINESS_TRACKER {
+  public:
+    int64_t timely, slack, useless;
+    uint64_t reports[4]; // reports per resulting priority
+    uint64_t unused_lookups, probes;
+
+    // thresholds of the cache filled at fill_level (FILL_L1, FILL_L2 or
+    // FILL_LLC)
+    explicit PF_TIMELINESS_TRACKER(int fill_level)
+        : timely(PF_TIMELY_L1D * scale(fill_level)),
+          slack(PF_SLACK_L1D * scale(fill_level)),
+          useless(PF_USELESS_L1D * scale(fill_level)),
+          unused_lookups(0), probes(0), entry(PF_TIMELINESS_ENTRIES) {
+        for (uint32_t i = 0; i < 4; i++)
+            reports[i] = 0;
+    }
+
+    uint8_t to_priority(int64_t timeliness) const {
+        if (timeliness < timely)
+            return 1;
+        if (timeliness < slack)
+            return 2;
+        if (timeliness < useless)
+            return 3;
+        return 0;
+    }
+
+    void report(uint64_t block, int64_t timeliness) {
+        ENTRY &e = entry[index(block)];
+        e.block = block;
+        e.priority = to_priority(timeliness);
+        e.late = timeliness < 0;
+        reports[e.priority]++;
+    }
+
+    // priority of the last report for block, unknown if there is none; a
+    // periodic probe turns 0 into 3
+    uint8_t priority(uint64_t block, uint8_t unknown) {
+        const ENTRY &e = entry[index(block)];
+        if (e.block != block)
+            return unknown;
+        if (e.priority == 0 &&
+            ++unused_lookups % PF_TIMELINESS_PROBE_PERIOD == 0) {
+            probes++;
+            return 3;
+        }
+        return e.priority;
+    }
+
+    // whether a demand caught the last prefetch of block in flight
+    uint8_t late(uint64_t block) const {
+        const ENTRY &e = entry[index(block)];
+        return e.block == block && e.late;
+    }
+
+    // priority shifted by the last report for block: one class more urgent
+    // if its prefetch was late or just in time, one less if it sat long or
+    // went unused; unchanged without a report
+    uint8_t adjust(uint64_t block, uint8_t priority) const {
+        const ENTRY &e = entry[index(block)];
+        if (e.block != block)
+            return priority;
+        if (e.priority == 1 && priority > 1)
+            return priority - 1;
+        if ((e.priority == 3 || e.priority == 0) && priority < 3)
+            return priority + 1;
+        return priority;
+    }
+
+    void print(const char *name) const {
+        cout << name << " timeliness reports P1: " << reports[1]
+             << "  P2: " << reports[2] << "  P3: " << reports[3]
+             << "  unused: " << reports[0] << "  probes: " << probes
+             << endl;
+    }
+
+  private:
+    struct ENTRY {
+        uint64_t block;
+        uint8_t priority, late;
+
+        ENTRY() : block(UINT64_MAX), priority(0), late(0) {}
+    };
+    std::vector<ENTRY> entry;
+
+    static uint32_t index(uint64_t block) {
+        return (block ^ (block >> 12)) & (PF_TIMELINESS_ENTRIES - 1);
+    }
+
+    static int64_t scale(int fill_level) {
+        return fill_level == FILL_L1 ? 1 : fill_level == FILL_L2 ? 2 : 4;
+    }
+};
+
+// CACHE::report_timeliness_function feeding tracker, e.g.
+//   report_timeliness_function = pf_timeliness_report<l2c_timeliness>;
+template <PF_TIMELINESS_TRACKER &tracker>
+void pf_timeliness_report(uint64_t full_addr, int64_t timeliness,
+                          uint64_t cur_clk) {
+    tracker.report(full_addr >> LOG2_BLOCK_SIZE, timeliness);
+}
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "champsim.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILE_TIMESTAMP() __rdtsc()
+#else
+#include <chrono>
+#define PROFILE_TIMESTAMP()                                                    \
+    ((uint64_t)std::chrono::steady_clock::now().time_since_epoch().count())
+#endif
+
+// Simulator self-profiler
+//
+// With -profile, one simulated cycle out of every PROFILE_SAMPLE_PERIOD has
+// its main-loop stages, cache levels, DRAM controller and prefetcher hooks
+// timed with the timestamp counter. Regions nest and each one is charged its
+// exclusive time, so a cache's share does not include the prefetcher it
+// calls. Unsampled cycles only test one flag per region.
+
+#define PROFILE_SAMPLE_PERIOD 64 // must be a power of two
+
+#define PROF_CYCLE_OTHER 0
+#define PROF_RETIRE 1
+#define PROF_UPDATE_ROB 2
+#define PROF_SCHEDULE 3
+#define PROF_EXECUTE 4
+#define PROF_LSQ 5
+#define PROF_DECODE 6
+#define PROF_FETCH 7
+#define PROF_TRACE_READ 8
+#define PROF_ITLB 9
+#define PROF_DTLB 10
+#define PROF_STLB 11
+#define PROF_L1I 12
+#define PROF_L1D 13
+#define PROF_L2C 14
+#define PROF_LLC 15
+#define PROF_DRAM 16
+#define PROF_PF_L1I 17
+#define PROF_PF_L1D 18
+#define PROF_PF_L2C 19
+#define PROF_PF_LLC 20
+#define NUM_PROF_REGIONS 21
+
+class PROFILE_SCOPE;
+
+class PROFILER {
+  public:
+    uint8_t enabled, sampling;
+    uint64_t cycle, sampled_cycles;
+    uint64_t ticks[NUM_PROF_REGIONS], calls[NUM_PROF_REGIONS];
+    PROFILE_SCOPE *top;
+
+    PROFILER()
+        : enabled(0), sampling(0), cycle(0), sampled_cycles(0), top(NULL) {
+        for (uint32_t i = 0; i < NUM_PROF_REGIONS; i++) {
+            ticks[i] = 0;
+            calls[i] = 0;
+        }
+    }
+
+    // called once per simulated cycle, outside of any region
+    void next_cycle() {
+        sampling = enabled && ((++cycle & (PROFILE_SAMPLE_PERIOD - 1)) == 0);
+        sampled_cycles += sampling;
+    }
+
+    void report(double wall_seconds);
+};
+
+extern PROFILER profiler;
+
+class PROFILE_SCOPE {
+  public:
+    uint64_t start, child;
+    PROFILE_SCOPE *parent;
+    uint8_t region, active;
+
+    PROFILE_SCOPE(uint8_t r) : region(r), active(profiler.sampling) {
+        if (!active)
+            return;
+        parent = profiler.top;
+        profiler.top = this;
+        child = 0;
+        start = PROFILE_TIMESTAMP();
+    }
+
+    ~PROFILE_SCOPE() { stop(); }
+
+    // end the region before the enclosing block does; scopes must still be
+    // stopped in reverse order of creation
+    void stop() {
+        if (!active)
+            return;
+        active = 0;
+        uint64_t elapsed = PROFILE_TIMESTAMP() - start;
+        profiler.ticks[region] += elapsed - child;
+        profiler.calls[region]++;
+        if (parent)
+            parent->child += elapsed;
+        profiler.top = parent;
+    }
+};
+
+#define PROFILE_CALL(region, ...)                                              \
+    do {                                                                       \
+        PROFILE_SCOPE profile_scope(region);                                   \
+        __VA_ARGS__;                                                           \
+    } while (0)
+
+#endif
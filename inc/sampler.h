@@ -0,0 +1,98 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "champsim.h"
+
+// Interval time-series sampler
+//
+// Every SAMPLE_INTERVAL cycles (of CPU 0) the simulator thread snapshots the
+// per-core progress, DRAM queue state and priority mechanism activity into a
+// fixed-size SAMPLE_ROW and pushes it into a ring buffer. A background thread
+// drains the ring and appends the raw rows to a binary file, so the hot loop
+// never formats text or touches the file system.
+//
+// File layout: one SAMPLE_FILE_HEADER followed by a packed array of
+// SAMPLE_ROW. All fields are little-endian host order.
+
+#define SAMPLE_FILE_MAGIC 0x454c504d41535343ULL // "CSSAMPLE"
+#define SAMPLE_FILE_VERSION 1
+#define SAMPLE_RING_SIZE 4096
+#define SAMPLE_WRITE_BATCH 256
+
+struct SAMPLE_FILE_HEADER {
+    uint64_t magic;
+    uint32_t version, row_size, num_cpus, dram_channels;
+    uint64_t interval;
+};
+
+struct SAMPLE_ROW {
+    uint64_t cycle; // CPU 0 cycle at the end of the interval
+
+    // per-core deltas over the interval
+    uint64_t retired[NUM_CPUS], cycles[NUM_CPUS];
+
+    // instantaneous cache MSHR occupancy
+    uint32_t l1d_mshr[NUM_CPUS], l2c_mshr[NUM_CPUS], llc_mshr;
+
+    // prefetches issued at L1D per priority (index 1-3), delta
+    uint32_t l1d_pf_issued[NUM_CPUS][4];
+
+    // instantaneous DRAM queue occupancy
+    uint32_t dram_rq[DRAM_CHANNELS], dram_wq[DRAM_CHANNELS],
+        dram_lower_rq[DRAM_CHANNELS];
+
+    // data bus busy cycles, delta
+    uint64_t dbus_busy[DRAM_CHANNELS];
+
+    // priority mechanism events, delta
+    uint64_t promotions, demotions, nacks;
+};
+
+class INTERVAL_SAMPLER {
+  public:
+    uint8_t enabled;
+    uint64_t interval, next_sample_cycle;
+
+    INTERVAL_SAMPLER()
+        : enabled(0), interval(0), next_sample_cycle(UINT64_MAX), file(NULL),
+          head(0), tail(0), stop(0), rows_written(0) {}
+
+    // open the output file and start the writer thread; sampling begins at
+    // the current cycle
+    void start(const char *path, uint64_t sample_interval);
+
+    // take a snapshot and enqueue it; called from the main loop only when
+    // current_core_cycle[0] >= next_sample_cycle
+    void sample();
+
+    // flush everything that is still queued and join the writer thread
+    void finish();
+
+  private:
+    FILE *file;
+    SAMPLE_ROW ring[SAMPLE_RING_SIZE];
+    uint64_t head, tail; // head: next row to produce, tail: next to write
+    uint8_t stop;
+    uint64_t rows_written;
+
+    std::mutex lock;
+    std::condition_variable has_rows, has_space;
+    std::thread writer;
+
+    // counter values at the previous sample
+    uint64_t last_retired[NUM_CPUS], last_cycle[NUM_CPUS];
+    int last_pf_issued[NUM_CPUS][4];
+    uint64_t last_dbus_busy[DRAM_CHANNELS];
+    uint64_t last_promotions, last_demotions, last_nacks;
+
+    void snapshot_counters();
+    void writer_loop();
+};
+
+extern INTERVAL_SAMPLER sampler;
+
+#endif
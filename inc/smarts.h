@@ -0,0 +1,103 @@
+#ifndef SMARTS_H
+#define SMARTS_H
+
+#include "champsim.h"
+
+// SMARTS-style sampled simulation (single core)
+//
+// After warmup the run alternates between functional fast-forward and short
+// detailed windows, one window every SMARTS period instructions:
+//
+//   | detailed warming | measured window | drain | functional warming ... |
+//
+// During functional warming O3_CPU::functional_warm() reads the trace
+// directly, training the branch predictor and installing every access in
+// the TLBs and caches (CACHE::warm_access), so only the microarchitectural
+// state that functional warming cannot reproduce (queues, MSHRs, prefetcher
+// tables) needs the detailed warming instructions. The drain phase stops
+// fetching until the pipeline and MSHRs are empty.
+//
+// Each measured window contributes one sample of CPI and of L1D/L2C/LLC
+// demand MPKI. The report gives the mean and its confidence interval at
+// SMARTS_Z standard errors; with a target error set, the run stops early
+// once the CPI interval is within that fraction of the mean.
+
+#define SMARTS_Z 3.0 // 99.7% confidence
+#define SMARTS_MIN_WINDOWS 30
+#define SMARTS_DRAIN_LIMIT 100000 // cycles
+
+enum SMARTS_PHASE { SMARTS_WARM, SMARTS_MEASURE, SMARTS_DRAIN };
+
+enum SMARTS_METRIC_ID {
+    SMARTS_CPI,
+    SMARTS_L1D_MPKI,
+    SMARTS_L2C_MPKI,
+    SMARTS_LLC_MPKI,
+    SMARTS_BRANCH_MPKI,
+    NUM_SMARTS_METRICS
+};
+
+struct SMARTS_METRIC {
+    double sum, sum_sq;
+    uint64_t n;
+
+    void add(double x) {
+        sum += x;
+        sum_sq += x * x;
+        n++;
+    }
+    double mean() const { return n ? sum / n : 0; }
+    // half width of the confidence interval of the mean
+    double interval() const;
+};
+
+class SMARTS_SAMPLER {
+  public:
+    uint8_t enabled;
+    uint64_t period, window, detailed_warmup;
+    double target_error;
+
+    SMARTS_SAMPLER()
+        : enabled(0), period(0), window(1000), detailed_warmup(2000),
+          target_error(0), phase(SMARTS_WARM), phase_start_instr(0),
+          phase_start_cycle(0), window_start_instr(0), detailed_instr(0),
+          functional_instr(0) {
+        for (int i = 0; i < NUM_SMARTS_METRICS; i++)
+            metric[i] = {0, 0, 0};
+    }
+
+    // fast-forward through the warmup instructions before the first cycle
+    void fast_forward_warmup(uint64_t instructions);
+
+    // begin sampling at the current instruction; called at finish_warmup()
+    void start();
+
+    // advance the phase state machine; called once per cycle after CPU 0
+    // has been operated
+    void operate();
+
+    // stop fetching while the pipeline drains
+    uint8_t fetch_blocked() const {
+        return enabled && phase == SMARTS_DRAIN;
+    }
+
+    void report();
+
+  private:
+    uint8_t phase;
+    uint64_t phase_start_instr, phase_start_cycle, window_start_instr;
+    uint64_t detailed_instr, functional_instr;
+
+    // counter values at the start of the measured window
+    uint64_t start_miss[3], start_branch_miss;
+
+    SMARTS_METRIC metric[NUM_SMARTS_METRICS];
+
+    uint64_t demand_misses(uint32_t level);
+    uint8_t drained();
+    void record_window();
+};
+
+extern SMARTS_SAMPLER smarts;
+
+#endif
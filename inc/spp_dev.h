@@ -39,6 +39,9 @@
 #define FILTER_SET (1 << QUOTIENT_BIT)
 #define FILL_THRESHOLD 90
 #define PF_THRESHOLD 25
+// lookahead depth under DRAM pressure, scaled down by MEMORY_PRESSURE level;
+// without pressure the lookahead runs until its confidence drops
+#define PRESSURE_LOOKAHEAD_DEPTH 8
 
 // Global register parameters
 #define GLOBAL_COUNTER_BIT 10
@@ -0,0 +1,84 @@
+#ifndef TRACE_SHM_H
+#define TRACE_SHM_H
+
+#include <atomic>
+#include <climits>
+#include <cstdlib>
+#include <string>
+
+#include "champsim.h"
+
+// Shared-memory trace broadcast
+//
+// scripts/trace_server.cc decompresses each trace once into a ring in POSIX
+// shared memory. Simulators given "-traces shm:<trace path>" attach to it as
+// readers instead of running their own decompressor. The ring holds a
+// stream of trace bytes addressed by absolute offset: the server only
+// overwrites bytes every active reader has passed, so readers advance at
+// their own pace and the slowest one holds back decompression.
+//
+// The server restarts the decompressor at the end of the trace, so the
+// stream never ends and readers see the trace repeat just as they would by
+// reopening it. A reader that attaches while the start of the current pass
+// is still in the ring replays it from there. Once it has been overwritten
+// the server turns the reader away and it runs its own decompressor, so runs
+// started at different times do not wait for each other's passes.
+
+#define TRACE_SHM_MAGIC 0x4d48534543415254ULL // "TRACESHM"
+#define TRACE_SHM_VERSION 2
+#define TRACE_SHM_READERS 64
+#define TRACE_SHM_CHUNK (1 << 20) // bytes decompressed per server step
+#define TRACE_SHM_POLL_US 50
+
+// reader slot states
+#define TRACE_SHM_FREE 0
+#define TRACE_SHM_WAITING 1 // attached, waiting for the start of a pass
+#define TRACE_SHM_ACTIVE 2
+#define TRACE_SHM_LATE 3 // the pass start is gone, decompress locally
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+              "the trace ring needs lock-free 64-bit atomics");
+
+struct TRACE_SHM_READER {
+    std::atomic<uint32_t> state;
+    std::atomic<int32_t> pid;
+    std::atomic<uint64_t> pos; // offset of the next byte to read
+};
+
+struct TRACE_SHM_HEADER {
+    uint64_t magic;
+    uint32_t version, server_pid;
+    uint64_t ring_size;
+    std::atomic<uint64_t> written; // end of the decompressed data
+    std::atomic<uint32_t> alive;
+    TRACE_SHM_READER reader[TRACE_SHM_READERS];
+};
+
+// the ring follows the header at this offset
+#define TRACE_SHM_DATA_OFFSET                                                  \
+    ((sizeof(TRACE_SHM_HEADER) + 4095) & ~(uint64_t)4095)
+
+// Shared-memory object name of a trace: both sides derive it from the
+// canonical path, so any spelling of the path finds the same ring.
+inline std::string trace_shm_name(const char *path) {
+    char resolved[PATH_MAX];
+    std::string full = realpath(path, resolved) ? resolved : path;
+
+    uint64_t hash = 0xcbf29ce484222325ULL; // FNV-1a
+    for (unsigned char c : full)
+        hash = (hash ^ c) * 0x100000001b3ULL;
+
+    char suffix[20];
+    snprintf(suffix, sizeof(suffix), ".%016llx", (unsigned long long)hash);
+    return "/champsim." + full.substr(full.find_last_of('/') + 1, 200) +
+           suffix;
+}
+
+// Attach to the ring serving `path` and return a stream over it for
+// O3_CPU::trace_file (src/trace_shm.cc). If the server turns the reader
+// away, the stream reads from `command`, the trace's own decompressor,
+// instead; either way it is closed with fclose(). Returns NULL if no server
+// has the trace.
+FILE *trace_shm_open(const char *path, const char *command);
+
+#endif
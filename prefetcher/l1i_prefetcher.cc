@@ -0,0 +1,17 @@
+#include "ooo_cpu.h"
+
+void O3_CPU::l1i_prefetcher_initialize() {}
+
+void O3_CPU::l1i_prefetcher_branch_operate(uint64_t ip, uint8_t branch_type,
+                                           uint64_t branch_target) {}
+
+void O3_CPU::l1i_prefetcher_cache_operate(uint64_t v_addr, uint8_t cache_hit,
+                                          uint8_t prefetch_hit) {}
+
+void O3_CPU::l1i_prefetcher_cycle_operate() {}
+
+void O3_CPU::l1i_prefetcher_cache_fill(uint64_t v_addr, uint32_t set,
+                                       uint32_t way, uint8_t prefetch,
+                                       uint64_t evicted_v_addr) {}
+
+void O3_CPU::l1i_prefetcher_final_stats() {}
@@ -2,6 +2,7 @@ import shlex
 import subprocess
 import os
 import re
+import sys
 
 # Build
 build = True
@@ -20,6 +21,13 @@ regex = ''
 # Parallelizing
 max_processes = 6
 
+# Decompress each trace once for all concurrent runs on it
+# (scripts/trace_server.cc). The ring must cover how far the fastest run
+# gets ahead of the slowest one.
+trace_server = False
+trace_server_ring_mb = 512
+trace_server_dir = '../dpc3_traces'  # TRACE_DIR in run_champsim.sh
+
 
 def check_processes(processes, end=False):
     if len(processes) < max_processes:
@@ -39,14 +47,34 @@ if __name__ == '__main__':
             os.system('./build_champsim.sh {}'.format(config))
 
     processes = []
+    server = None
     files = ["server_001.champsimtrace.xz","server_003.champsimtrace.xz",\
         "server_013.champsimtrace.xz","server_017.champsimtrace.xz",\
         "server_021.champsimtrace.xz","server_022.champsimtrace.xz",
         "server_036.champsimtrace.xz"]
-    for config in configs:
-        executable = '{}core'.format(config.replace(' ', '-'))
-        for bandwidth in bandwidths:
-            for file in files:
+    if trace_server:
+        os.system('g++ -O2 -std=c++11 -pthread -Iinc scripts/trace_server.cc '
+                  '-o bin/trace_server -lrt')
+        paths = ['{}/{}/{}'.format(trace_server_dir, trace_dir, file)
+                 for file in files]
+        server = subprocess.Popen(['bin/trace_server', '-r',
+                                   str(trace_server_ring_mb)] + paths,
+                                  stdout=subprocess.PIPE,
+                                  universal_newlines=True)
+        # no run may attach before every ring is published
+        for path in paths:
+            line = server.stdout.readline()
+            if not line.startswith('serving'):
+                server.wait()
+                sys.exit('trace_server failed to start')
+            print(line, end='')
+        os.environ['TRACE_PREFIX'] = 'shm:'
+
+    # runs on the same trace go together so they can share its ring
+    for file in files:
+        for config in configs:
+            executable = '{}core'.format(config.replace(' ', '-'))
+            for bandwidth in bandwidths:
                 output_file = 'results/{}M_{}B/{}-{}.txt'.format(simulation,
                                                                  bandwidth,
                                                                  file,
@@ -65,3 +93,6 @@ if __name__ == '__main__':
                     print(processes[-1].pid)
 
     check_processes(processes, end=True)
+    if server:
+        server.terminate()
+        server.wait()
@@ -50,7 +50,8 @@ fi
 
 filename=$(basename ${TRACE}-${BINARY}${OPTION}.txt)
 dirname results/${N_SIM}M_${BANDWIDTH}B/${filename} | xargs mkdir -p
-# echo "(./bin/${BINARY} -warmup_instructions ${N_WARM}000000 -simulation_instructions ${N_SIM}000000 -low_bandwidth ${BANDWIDTH}00 ${OPTION} -traces ${TRACE_DIR}/${TRACE}) &>results/${N_SIM}M_${BANDWIDTH}B/${filename}"
+# TRACE_PREFIX=shm: in the environment reads the trace from a running
+# scripts/trace_server instead of decompressing it
 (./bin/${BINARY} -warmup_instructions ${N_WARM}000000 -simulation_instructions ${N_SIM}000000 \
-    -low_bandwidth ${BANDWIDTH}00 ${OPTION} -traces ${TRACE_DIR}/${TRACE}) \
+    -low_bandwidth ${BANDWIDTH}00 ${OPTION} -traces ${TRACE_PREFIX}${TRACE_DIR}/${TRACE}) \
     &>results/${N_SIM}M_${BANDWIDTH}B/${filename}
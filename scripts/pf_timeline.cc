@@ -0,0 +1,175 @@
+// Rebuild per-prefetch timelines from a -pf_event_log file.
+//
+// Build: g++ -O2 -std=c++11 -Iinc -o bin/pf_timeline scripts/pf_timeline.cc
+// Usage: pf_timeline <log> [-a <block address in hex>] [-s]
+//   -a  only print timelines of one block address
+//   -s  only print the per-priority summary
+//
+// A timeline starts at PF_EVENT_ISSUE and collects the following events for
+// the same (cpu, block address) until the prefetch is used or evicted unused
+// at the level that issued it, or NACKed at that level or below. A NACK is
+// relayed up to every level holding an MSHR entry for the block; the copies
+// logged in the same cycle after the first are dropped.
+
+#include <map>
+#include <vector>
+
+#include "pf_event_log.h"
+
+static const char *event_names[NUM_PF_EVENTS] = {
+    "ISSUE", "ENQUEUE", "DEMOTE", "NACK", "PROMOTE", "FILL", "USE", "EVICT"};
+static const char *level_names[8] = {"ITLB", "DTLB", "STLB", "L1I",
+                                     "L1D",  "L2C",  "LLC",  "DRAM"};
+
+#define OUTCOME_USED 0
+#define OUTCOME_UNUSED 1
+#define OUTCOME_NACKED 2
+#define OUTCOME_IN_FLIGHT 3
+static const char *outcome_names[4] = {"used", "evicted unused", "nacked",
+                                       "in flight"};
+
+struct TIMELINE {
+    std::vector<PF_EVENT> event;
+};
+
+struct SUMMARY {
+    uint64_t outcome[4], demoted, promoted;
+    int64_t timeliness_sum;
+
+    SUMMARY() : demoted(0), promoted(0), timeliness_sum(0) {
+        for (int i = 0; i < 4; i++)
+            outcome[i] = 0;
+    }
+};
+
+static SUMMARY summary[4];
+static uint64_t filter_address = 0, orphans = 0;
+static bool summary_only = false;
+
+static void finish(TIMELINE *t, int outcome) {
+    const PF_EVENT &issue = t->event.front();
+    SUMMARY &s = summary[issue.priority & 3];
+    s.outcome[outcome]++;
+    for (size_t i = 0; i < t->event.size(); i++) {
+        if (t->event[i].type == PF_EVENT_DEMOTE)
+            s.demoted++;
+        if (t->event[i].type == PF_EVENT_PROMOTE)
+            s.promoted++;
+    }
+    if (outcome == OUTCOME_USED)
+        s.timeliness_sum += t->event.back().aux;
+
+    if (!summary_only && (!filter_address || filter_address == issue.address)) {
+        printf("cpu %u addr 0x%lx P%u @%lu:", issue.cpu,
+               (unsigned long)issue.address, issue.priority,
+               (unsigned long)issue.cycle);
+        for (size_t i = 0; i < t->event.size(); i++) {
+            const PF_EVENT &e = t->event[i];
+            printf(" %s+%lu %s %s P%u(%lld)", i ? "| " : "",
+                   (unsigned long)(e.cycle - issue.cycle),
+                   event_names[e.type], level_names[e.level & 7], e.priority,
+                   (long long)e.aux);
+        }
+        printf(" => %s\n", outcome_names[outcome]);
+    }
+    delete t;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <log> [-a <hex block address>] [-s]\n",
+                argv[0]);
+        return 1;
+    }
+    for (int i = 2; i < argc; i++) {
+        if (!strcmp(argv[i], "-a") && i + 1 < argc)
+            filter_address = strtoull(argv[++i], NULL, 16);
+        else if (!strcmp(argv[i], "-s"))
+            summary_only = true;
+    }
+
+    FILE *f = fopen(argv[1], "rb");
+    if (f == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    PF_EVENT_FILE_HEADER header;
+    if (fread(&header, sizeof(header), 1, f) != 1 ||
+        header.magic != PF_EVENT_FILE_MAGIC ||
+        header.version != PF_EVENT_FILE_VERSION ||
+        header.event_size != sizeof(PF_EVENT)) {
+        fprintf(stderr, "%s: not a prefetch event log\n", argv[1]);
+        return 1;
+    }
+
+    // open timelines per (cpu, block address), most recent last
+    std::map<std::pair<uint8_t, uint64_t>, std::vector<TIMELINE *>> open;
+    // cycle of the last NACK that closed a timeline, per (cpu, address)
+    std::map<std::pair<uint8_t, uint64_t>, uint64_t> nacked;
+
+    static PF_EVENT buffer[PF_EVENT_BUFFER_SIZE];
+    size_t n;
+    while ((n = fread(buffer, sizeof(PF_EVENT), PF_EVENT_BUFFER_SIZE, f))) {
+        for (size_t i = 0; i < n; i++) {
+            const PF_EVENT &e = buffer[i];
+            std::vector<TIMELINE *> &list = open[std::make_pair(e.cpu, e.address)];
+
+            if (e.type == PF_EVENT_ISSUE) {
+                list.push_back(new TIMELINE);
+                list.back()->event.push_back(e);
+                continue;
+            }
+            if (e.type == PF_EVENT_NACK) {
+                auto it = nacked.find(std::make_pair(e.cpu, e.address));
+                if (it != nacked.end() && it->second == e.cycle)
+                    continue;
+            }
+            if (list.empty()) {
+                orphans++;
+                continue;
+            }
+
+            TIMELINE *t = list.back();
+            t->event.push_back(e);
+
+            bool at_origin = (e.level == t->event.front().level);
+            int outcome = -1;
+            if (at_origin && e.type == PF_EVENT_USE)
+                outcome = OUTCOME_USED;
+            else if (at_origin && e.type == PF_EVENT_EVICT_UNUSED)
+                outcome = OUTCOME_UNUSED;
+            else if (e.type == PF_EVENT_NACK &&
+                     e.level >= t->event.front().level) {
+                outcome = OUTCOME_NACKED;
+                nacked[std::make_pair(e.cpu, e.address)] = e.cycle;
+            }
+            if (outcome != -1) {
+                list.pop_back();
+                finish(t, outcome);
+            }
+        }
+    }
+    fclose(f);
+
+    for (auto &it : open)
+        for (size_t i = 0; i < it.second.size(); i++)
+            finish(it.second[i], OUTCOME_IN_FLIGHT);
+
+    printf("\npriority     issued       used     unused     nacked  in_flight "
+           "   demoted   promoted  avg_timeliness\n");
+    for (int p = 0; p < 4; p++) {
+        SUMMARY &s = summary[p];
+        uint64_t issued = s.outcome[0] + s.outcome[1] + s.outcome[2] +
+                          s.outcome[3];
+        if (issued == 0)
+            continue;
+        printf("%8d %10lu %10lu %10lu %10lu %10lu %10lu %10lu %15.1f\n", p,
+               (unsigned long)issued, (unsigned long)s.outcome[0],
+               (unsigned long)s.outcome[1], (unsigned long)s.outcome[2],
+               (unsigned long)s.outcome[3], (unsigned long)s.demoted,
+               (unsigned long)s.promoted,
+               s.outcome[0] ? (1.0 * s.timeliness_sum) / s.outcome[0] : 0.0);
+    }
+    printf("events without an open timeline: %lu\n", (unsigned long)orphans);
+    return 0;
+}
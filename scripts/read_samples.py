@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+# Decode the binary time series written with -sample_interval/-sample_file
+# into CSV on stdout. Row layout mirrors SAMPLE_ROW in inc/sampler.h.
+import struct
+import sys
+
+MAGIC = 0x454c504d41535343
+VERSION = 1
+
+
+def row_format(ncpu, nch):
+    fmt = '@Q' + 'Q' * ncpu * 2 + 'I' * ncpu * 2 + 'I' + 'I' * ncpu * 4
+    fmt += 'I' * nch * 3 + 'Q' * nch + 'QQQ'
+    return fmt
+
+
+def main(path):
+    data = open(path, 'rb').read()
+    magic, version, row_size, ncpu, nch, interval = struct.unpack_from(
+        '<QIIIIQ', data, 0)
+    if magic != MAGIC or version != VERSION:
+        sys.exit('%s: not a sample file (or unsupported version)' % path)
+    fmt = row_format(ncpu, nch)
+    assert struct.calcsize(fmt) <= row_size
+
+    cols = ['cycle']
+    cols += ['ipc%d' % c for c in range(ncpu)]
+    cols += ['l1d_mshr%d' % c for c in range(ncpu)]
+    cols += ['l2c_mshr%d' % c for c in range(ncpu)]
+    cols += ['llc_mshr']
+    cols += ['pf%d_p%d' % (c, p) for c in range(ncpu) for p in range(1, 4)]
+    cols += ['rq%d' % ch for ch in range(nch)]
+    cols += ['wq%d' % ch for ch in range(nch)]
+    cols += ['lower_rq%d' % ch for ch in range(nch)]
+    cols += ['dbus_util%d' % ch for ch in range(nch)]
+    cols += ['promotions', 'demotions', 'nacks']
+    print(','.join(cols))
+
+    offset = struct.calcsize('<QIIIIQ')
+    while offset + row_size <= len(data):
+        v = struct.unpack_from(fmt, data, offset)
+        offset += row_size
+        i = 0
+        out = [v[i]]
+        i += 1
+        retired, cycles = v[i:i + ncpu], v[i + ncpu:i + 2 * ncpu]
+        i += 2 * ncpu
+        out += ['%.4f' % (r / c if c else 0) for r, c in zip(retired, cycles)]
+        out += v[i:i + 2 * ncpu + 1]
+        i += 2 * ncpu + 1
+        pf = v[i:i + 4 * ncpu]
+        i += 4 * ncpu
+        out += [pf[c * 4 + p] for c in range(ncpu) for p in range(1, 4)]
+        out += v[i:i + 3 * nch]
+        i += 3 * nch
+        out += ['%.4f' % (b / interval) for b in v[i:i + nch]]
+        i += nch
+        out += v[i:i + 3]
+        print(','.join(str(x) for x in out))
+
+
+if __name__ == '__main__':
+    if len(sys.argv) != 2:
+        sys.exit('usage: %s <sample file>' % sys.argv[0])
+    main(sys.argv[1])
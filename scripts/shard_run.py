@@ -0,0 +1,189 @@
+#!/usr/bin/env python3
+# Simulate one long trace as K contiguous intervals in parallel and merge the
+# per-shard statistics into whole-run numbers.
+#
+# The measured region is the same as a single run with -warmup_instructions W
+# -simulation_instructions N: instructions [W, W + N). Shard k measures
+# [W + k*N/K, W + (k+1)*N/K). It seeks to overlap instructions before its
+# detailed warmup (-skip_instructions), warms caches and predictors
+# functionally over them (-functional_warmup), then runs W detailed warmup
+# instructions before its interval. Shard 0 is exactly the first interval of
+# the single run.
+#
+# usage: shard_run.py [-shards K] [-overlap O] [-warmup W] [-o DIR]
+#                     binary trace instructions [simulator options...]
+import argparse
+import os
+import re
+import shlex
+import subprocess
+import sys
+
+CACHES = ['L1D', 'L1I', 'L2C', 'LLC']
+TYPES = ['TOTAL', 'LOAD', 'RFO', 'PREFETCH', 'WRITEBACK']
+
+ROI_RE = re.compile(r'CPU 0 cumulative IPC: \S+ instructions: (\d+) '
+                    r'cycles: (\d+)')
+ACCESS_RE = re.compile(r'^(\w+) (\w+)\s+ACCESS:\s+(\d+)\s+HIT:\s+(\d+)\s+'
+                       r'MISS:\s+(\d+)')
+PREFETCH_RE = re.compile(r'^(\w+) PREFETCH  REQUESTED:\s+(\d+)\s+ISSUED:\s+'
+                         r'(\d+)\s+USEFUL:\s+(\d+)\s+USELESS:\s+(\d+)')
+LATENCY_RE = re.compile(r'^(\w+) AVERAGE MISS LATENCY: (\S+) cycles')
+BRANCH_RE = re.compile(r'^CPU 0 Branches: (\d+) Mispredictions: (\d+)')
+ROW_RE = re.compile(r'^ (RQ|WQ) ROW_BUFFER_HIT:\s+(\d+)\s+'
+                    r'ROW_BUFFER_MISS:\s+(\d+)')
+
+
+def shard_commands(args):
+    interval = args.instructions // args.shards
+    commands = []
+    for k in range(args.shards):
+        start = k * interval
+        length = interval if k < args.shards - 1 else \
+            args.instructions - start
+        skip = max(0, start - args.overlap)
+        cli = '{} -warmup_instructions {} -simulation_instructions {} ' \
+              '-skip_instructions {} -functional_warmup {} {} -traces {}'
+        commands.append(cli.format(args.binary, args.warmup, length, skip,
+                                   start - skip, ' '.join(args.options),
+                                   args.trace))
+    return commands
+
+
+def parse(path):
+    stats = {'instructions': 0, 'cycles': 0, 'mispredictions': 0,
+             'branches': 0}
+    roi = False
+    for line in open(path):
+        if line.startswith('Region of Interest Statistics'):
+            roi = True
+        if not roi:
+            continue
+
+        m = ROI_RE.match(line)
+        if m:
+            stats['instructions'] = int(m.group(1))
+            stats['cycles'] = int(m.group(2))
+            continue
+        m = ACCESS_RE.match(line)
+        if m and m.group(2) in TYPES:
+            stats[(m.group(1), m.group(2))] = [int(x) for x in m.groups()[2:]]
+            continue
+        m = PREFETCH_RE.match(line)
+        if m:
+            stats[(m.group(1), 'PF')] = [int(x) for x in m.groups()[1:]]
+            continue
+        m = LATENCY_RE.match(line)
+        if m:
+            latency = float(m.group(2))
+            stats[(m.group(1), 'LAT')] = 0.0 if latency != latency else latency
+            continue
+        m = BRANCH_RE.match(line)
+        if m:
+            stats['branches'] = int(m.group(1))
+            stats['mispredictions'] = int(m.group(2))
+            continue
+        m = ROW_RE.match(line)
+        if m:
+            key = ('DRAM', m.group(1))
+            old = stats.get(key, [0, 0])
+            stats[key] = [old[0] + int(m.group(2)), old[1] + int(m.group(3))]
+
+    if not stats['instructions']:
+        sys.exit('%s: no region of interest statistics' % path)
+    return stats
+
+
+def add(a, b):
+    return [x + y for x, y in zip(a, b)]
+
+
+def merge(shards):
+    total = {'instructions': sum(s['instructions'] for s in shards),
+             'cycles': sum(s['cycles'] for s in shards),
+             'mispredictions': sum(s['mispredictions'] for s in shards),
+             'branches': sum(s['branches'] for s in shards)}
+    for s in shards:
+        for key, value in s.items():
+            if isinstance(key, tuple) and key[1] != 'LAT':
+                total[key] = add(total[key], value) if key in total else value
+
+    # average miss latency, weighted by each shard's total misses
+    for cache in CACHES:
+        weighted = sum(s.get((cache, 'LAT'), 0) *
+                       s.get((cache, 'TOTAL'), [0, 0, 0])[2] for s in shards)
+        misses = total.get((cache, 'TOTAL'), [0, 0, 0])[2]
+        total[(cache, 'LAT')] = weighted / misses if misses else 0
+    return total
+
+
+def report(total, shards):
+    instructions, cycles = total['instructions'], total['cycles']
+    print('Merged Statistics (%d shards)' % len(shards))
+    print()
+    for k, s in enumerate(shards):
+        print('Shard %d IPC: %g instructions: %d cycles: %d' % (
+            k, s['instructions'] / s['cycles'], s['instructions'],
+            s['cycles']))
+    print()
+    print('CPU 0 cumulative IPC: %g instructions: %d cycles: %d' % (
+        instructions / cycles, instructions, cycles))
+    for cache in CACHES:
+        for t in TYPES:
+            if (cache, t) in total:
+                print('%s %-9s ACCESS: %10d  HIT: %10d  MISS: %10d' % (
+                    (cache, t) + tuple(total[(cache, t)])))
+        if (cache, 'PF') in total:
+            print('%s PREFETCH  REQUESTED: %10d  ISSUED: %10d  USEFUL: %10d  '
+                  'USELESS: %10d' % ((cache,) + tuple(total[(cache, 'PF')])))
+        if (cache, 'TOTAL') in total:
+            print('%s AVERAGE MISS LATENCY: %g cycles' % (
+                cache, total[(cache, 'LAT')]))
+            print('%s MPKI: %g' % (
+                cache, 1000.0 * total[(cache, 'TOTAL')][2] / instructions))
+    for q in ['RQ', 'WQ']:
+        if ('DRAM', q) in total:
+            print('DRAM %s ROW_BUFFER_HIT: %10d  ROW_BUFFER_MISS: %10d' % (
+                (q,) + tuple(total[('DRAM', q)])))
+    if total['branches']:
+        print('CPU 0 Branch Prediction Accuracy: %g%% MPKI: %g' % (
+            100 * (1 - total['mispredictions'] / total['branches']),
+            1000 * total['mispredictions'] / instructions))
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Simulate a trace as parallel interval shards')
+    parser.add_argument('-shards', type=int, default=os.cpu_count())
+    parser.add_argument('-overlap', type=int, default=10000000,
+                        help='functional warmup instructions per shard')
+    parser.add_argument('-warmup', type=int, default=1000000,
+                        help='detailed warmup instructions per shard')
+    parser.add_argument('-o', dest='output', default='shards',
+                        help='directory for the per-shard logs')
+    parser.add_argument('binary')
+    parser.add_argument('trace')
+    parser.add_argument('instructions', type=int)
+    parser.add_argument('options', nargs=argparse.REMAINDER)
+    args = parser.parse_args()
+
+    os.makedirs(args.output, exist_ok=True)
+    processes, logs = [], []
+    for k, cli in enumerate(shard_commands(args)):
+        log = os.path.join(args.output, 'shard_%d.txt' % k)
+        print(cli, '>', log)
+        processes.append(subprocess.Popen(shlex.split(cli),
+                                          stdout=open(log, 'w'),
+                                          stderr=subprocess.STDOUT))
+        logs.append(log)
+
+    for k, process in enumerate(processes):
+        if process.wait():
+            sys.exit('shard %d failed, see %s' % (k, logs[k]))
+
+    shards = [parse(log) for log in logs]
+    report(merge(shards), shards)
+
+
+if __name__ == '__main__':
+    main()
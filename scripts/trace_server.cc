@@ -0,0 +1,226 @@
+// Decompress traces once into shared memory for concurrent simulator runs.
+//
+// Build: g++ -O2 -std=c++11 -pthread -Iinc scripts/trace_server.cc
+//            -o bin/trace_server -lrt
+// Usage: trace_server [-r <ring MB>] <trace> [<trace> ...]
+//   -r  ring size per trace in MB (default 512)
+//
+// Each trace gets a ring in shared memory (see inc/trace_shm.h) and a thread
+// that keeps it filled from one "xz -dc" / "gzip -dc" pipeline. Simulators
+// read it with "-traces shm:<trace>". The server runs until SIGINT or
+// SIGTERM and then removes the shared-memory objects.
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "trace_shm.h"
+
+static volatile sig_atomic_t stop = 0;
+
+static void handle_stop(int) { stop = 1; }
+
+struct TRACE_RING {
+    std::string path, name, command;
+    TRACE_SHM_HEADER *header;
+    char *ring;
+    uint64_t map_size;
+};
+
+static FILE *open_decompressor(TRACE_RING &t) {
+    FILE *f = popen(t.command.c_str(), "r");
+    if (f == NULL) {
+        fprintf(stderr, "cannot run %s\n", t.command.c_str());
+        exit(1);
+    }
+    return f;
+}
+
+// Feed one ring until stopped. A pass is one run of the decompressor over
+// the whole trace; waiting readers join at the start of a pass while it is
+// still in the ring, and are turned away to decompress on their own once it
+// is not, rather than holding them until the active readers finish.
+static void serve(TRACE_RING *t) {
+    TRACE_SHM_HEADER *header = t->header;
+    FILE *f = NULL;
+    uint64_t pass_start = 0;
+    uint64_t passes = 0, late = 0;
+
+    while (!stop) {
+        uint64_t written = header->written.load(std::memory_order_relaxed),
+                 min_pos = written;
+        uint32_t active = 0, waiting = 0;
+
+        for (uint32_t i = 0; i < TRACE_SHM_READERS; i++) {
+            TRACE_SHM_READER &r = header->reader[i];
+            uint32_t state = r.state.load(std::memory_order_acquire);
+            if (state == TRACE_SHM_FREE)
+                continue;
+
+            // a simulator that exited without closing its stream
+            int32_t pid = r.pid.load(std::memory_order_acquire);
+            if (pid && kill(pid, 0) && errno == ESRCH) {
+                r.pid.store(0, std::memory_order_relaxed);
+                r.state.store(TRACE_SHM_FREE, std::memory_order_release);
+                continue;
+            }
+
+            if (state == TRACE_SHM_ACTIVE) {
+                active++;
+                min_pos = min(min_pos, r.pos.load(std::memory_order_acquire));
+            } else if (state == TRACE_SHM_WAITING)
+                waiting++;
+        }
+
+        if (!active && !waiting) {
+            usleep(1000);
+            continue;
+        }
+
+        // nobody is mid-pass: start a new pass right away for the waiting
+        if (!active && (f == NULL || written != pass_start)) {
+            if (f)
+                pclose(f);
+            f = open_decompressor(*t);
+            pass_start = written;
+            passes++;
+        }
+
+        // bytes from pass_start are intact until the ring wraps over them
+        if (waiting) {
+            uint8_t replay = pass_start + header->ring_size >= written;
+            for (uint32_t i = 0; i < TRACE_SHM_READERS; i++) {
+                TRACE_SHM_READER &r = header->reader[i];
+                if (r.state.load(std::memory_order_acquire) !=
+                    TRACE_SHM_WAITING)
+                    continue;
+                if (replay) {
+                    r.pos.store(pass_start, std::memory_order_relaxed);
+                    r.state.store(TRACE_SHM_ACTIVE, std::memory_order_release);
+                    min_pos = min(min_pos, pass_start);
+                } else {
+                    r.state.store(TRACE_SHM_LATE, std::memory_order_release);
+                    late++;
+                }
+            }
+        }
+
+        uint64_t space = header->ring_size - (written - min_pos),
+                 offset = written % header->ring_size,
+                 want = min(space, min((uint64_t)TRACE_SHM_CHUNK,
+                                       header->ring_size - offset));
+        if (want == 0) {
+            usleep(TRACE_SHM_POLL_US);
+            continue;
+        }
+
+        size_t got = fread(t->ring + offset, 1, want, f);
+        if (got)
+            header->written.store(written + got, std::memory_order_release);
+        else {
+            // end of the trace: the stream continues with the next pass
+            pclose(f);
+            f = open_decompressor(*t);
+            pass_start = written;
+            passes++;
+        }
+    }
+
+    if (f)
+        pclose(f);
+    printf("%s: %llu passes, %llu MB decompressed, %llu late readers\n",
+           t->path.c_str(), (unsigned long long)passes,
+           (unsigned long long)(header->written.load() >> 20),
+           (unsigned long long)late);
+}
+
+int main(int argc, char **argv) {
+    uint64_t ring_mb = 512;
+    vector<TRACE_RING> traces;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            ring_mb = atol(argv[++i]);
+            continue;
+        }
+
+        TRACE_RING t;
+        t.path = argv[i];
+        if (access(argv[i], R_OK)) {
+            fprintf(stderr, "TRACE FILE NOT FOUND: %s\n", argv[i]);
+            return 1;
+        }
+        const char *dot = strrchr(argv[i], '.');
+        if (dot && dot[1] == 'g')
+            t.command = "gzip -dc ";
+        else if (dot && dot[1] == 'x')
+            t.command = "xz -dc ";
+        else {
+            fprintf(stderr, "only gz or xz traces are supported: %s\n",
+                    argv[i]);
+            return 1;
+        }
+        t.command += "'" + t.path + "'";
+        t.name = trace_shm_name(argv[i]);
+        traces.push_back(t);
+    }
+    if (traces.empty() || ring_mb == 0) {
+        fprintf(stderr, "usage: %s [-r <ring MB>] <trace> [<trace> ...]\n",
+                argv[0]);
+        return 1;
+    }
+
+    for (TRACE_RING &t : traces) {
+        t.map_size = TRACE_SHM_DATA_OFFSET + (ring_mb << 20);
+        shm_unlink(t.name.c_str());
+        int fd = shm_open(t.name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0 || ftruncate(fd, t.map_size)) {
+            fprintf(stderr, "cannot create %s: %s\n", t.name.c_str(),
+                    strerror(errno));
+            return 1;
+        }
+        void *map = mmap(NULL, t.map_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) {
+            fprintf(stderr, "cannot map %s: %s\n", t.name.c_str(),
+                    strerror(errno));
+            return 1;
+        }
+
+        // the object starts zeroed, so every reader slot is free
+        t.header = (TRACE_SHM_HEADER *)map;
+        t.ring = (char *)map + TRACE_SHM_DATA_OFFSET;
+        t.header->server_pid = getpid();
+        t.header->ring_size = ring_mb << 20;
+        t.header->version = TRACE_SHM_VERSION;
+        t.header->alive.store(1);
+        __atomic_store_n(&t.header->magic, TRACE_SHM_MAGIC, __ATOMIC_RELEASE);
+        printf("serving %s as shm:%s (%s)\n", t.path.c_str(), t.path.c_str(),
+               t.name.c_str());
+    }
+    fflush(stdout);
+
+    signal(SIGINT, handle_stop);
+    signal(SIGTERM, handle_stop);
+    signal(SIGPIPE, SIG_IGN);
+
+    vector<std::thread> threads;
+    for (TRACE_RING &t : traces)
+        threads.push_back(std::thread(serve, &t));
+    for (std::thread &thread : threads)
+        thread.join();
+
+    for (TRACE_RING &t : traces) {
+        t.header->alive.store(0);
+        shm_unlink(t.name.c_str());
+        munmap(t.header, t.map_size);
+    }
+    return 0;
+}
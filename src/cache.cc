@@ -1,4 +1,6 @@
 #include "cache.h"
+#include "pf_event_log.h"
+#include "pf_insertion.h"
 #include "set.h"
 
 uint64_t l2pf_access = 0;
@@ -74,7 +76,10 @@ void CACHE::handle_fill() {
         }
 
         if (do_fill) {
+            evict_unused_prefetch(set, way);
+
             // update prefetcher
+            PROFILE_SCOPE prefetcher_scope(prefetcher_profile_region());
             if (cache_type == IS_L1I)
                 l1i_prefetcher_cache_fill(
                     fill_cpu,
@@ -104,13 +109,16 @@ void CACHE::handle_fill() {
                     MSHR.entry[mshr_index].pf_metadata);
                 cpu = 0;
             }
+            prefetcher_scope.stop();
 
             // update replacement policy
             if (cache_type == IS_LLC) {
                 llc_update_replacement_state(
                     fill_cpu, set, way, MSHR.entry[mshr_index].full_addr,
                     MSHR.entry[mshr_index].ip, block[set][way].full_addr,
-                    MSHR.entry[mshr_index].type, 0);
+                    MSHR.entry[mshr_index].type, 0,
+                    MSHR.entry[mshr_index].type == PREFETCH,
+                    pf_insertion_priority(MSHR.entry[mshr_index]));
             } else
                 update_replacement_state(
                     fill_cpu, set, way, MSHR.entry[mshr_index].full_addr,
@@ -177,6 +185,9 @@ void CACHE::handle_fill() {
                     (current_core_cycle[fill_cpu] -
                      MSHR.entry[mshr_index].cycle_enqueued);
                 total_miss_latency += current_miss_latency;
+                miss_latency_hist[MSHR.entry[mshr_index].type]
+                                 [MSHR.entry[mshr_index].priority]
+                                     .record(current_miss_latency);
             }
 
             MSHR.remove_queue(&MSHR.entry[mshr_index]);
@@ -207,7 +218,8 @@ void CACHE::handle_writeback() {
             if (cache_type == IS_LLC) {
                 llc_update_replacement_state(
                     writeback_cpu, set, way, block[set][way].full_addr,
-                    WQ.entry[index].ip, 0, WQ.entry[index].type, 1);
+                    WQ.entry[index].ip, 0, WQ.entry[index].type, 1, 0,
+                    WQ.entry[index].priority);
 
             } else
                 update_replacement_state(
@@ -425,7 +437,10 @@ void CACHE::handle_writeback() {
                 }
 
                 if (do_fill) {
+                    evict_unused_prefetch(set, way);
+
                     // update prefetcher
+                    PROFILE_SCOPE prefetcher_scope(prefetcher_profile_region());
                     if (cache_type == IS_L1I)
                         l1i_prefetcher_cache_fill(
                             writeback_cpu,
@@ -452,13 +467,15 @@ void CACHE::handle_writeback() {
                             WQ.entry[index].pf_metadata);
                         cpu = 0;
                     }
+                    prefetcher_scope.stop();
 
                     // update replacement policy
                     if (cache_type == IS_LLC) {
                         llc_update_replacement_state(
                             writeback_cpu, set, way, WQ.entry[index].full_addr,
                             WQ.entry[index].ip, block[set][way].full_addr,
-                            WQ.entry[index].type, 0);
+                            WQ.entry[index].type, 0, 0,
+                            WQ.entry[index].priority);
                     } else
                         update_replacement_state(
                             writeback_cpu, set, way, WQ.entry[index].full_addr,
@@ -548,6 +565,7 @@ void CACHE::handle_read() {
                 }
 
                 // update prefetcher on load instruction
+                PROFILE_SCOPE prefetcher_scope(prefetcher_profile_region());
                 if (RQ.entry[index].type == LOAD) {
                     if (cache_type == IS_L1I)
                         l1i_prefetcher_cache_operate(read_cpu,
@@ -569,12 +587,15 @@ void CACHE::handle_read() {
                         cpu = 0;
                     }
                 }
+                prefetcher_scope.stop();
 
                 // update replacement policy
                 if (cache_type == IS_LLC) {
                     llc_update_replacement_state(
                         read_cpu, set, way, block[set][way].full_addr,
-                        RQ.entry[index].ip, 0, RQ.entry[index].type, 1);
+                        RQ.entry[index].ip, 0, RQ.entry[index].type, 1,
+                        RQ.entry[index].type == PREFETCH,
+                        pf_insertion_priority(RQ.entry[index]));
 
                 } else
                     update_replacement_state(
@@ -612,9 +633,20 @@ void CACHE::handle_read() {
                     pf_useful++;
                     block[set][way].prefetch = 0;
                     if (!block[set][way].used) {
+                        pf_class_stats[PF_CLASS_USEFUL]
+                                      [block[set][way].pf_priority]++;
                         // Count timeliness
                         int64_t timeliness = (current_core_cycle[read_cpu] -
                                               block[set][way].cycle_prefetched);
+                        if (warmup_complete[read_cpu])
+                            pf_timeliness_hist[block[set][way].pf_priority]
+                                .record(timeliness);
+                        record_pf_lead(block[set][way].pf_priority,
+                                       block[set][way].pf_parked, timeliness);
+                        pf_event_log.record(
+                            PF_EVENT_USE, cache_type, read_cpu,
+                            block[set][way].address,
+                            block[set][way].pf_priority, timeliness);
                         if (report_timeliness_function) {
                             report_timeliness_function(
                                 block[set][way].full_addr, timeliness,
@@ -795,13 +827,20 @@ void CACHE::handle_read() {
                                 MSHR.entry[mshr_index].returned;
                             uint64_t prior_event_cycle =
                                 MSHR.entry[mshr_index].event_cycle;
+                            uint8_t prior_priority =
+                                MSHR.entry[mshr_index].priority;
+                            uint64_t prior_parked =
+                                MSHR.entry[mshr_index].pf_parked;
                             MSHR.entry[mshr_index] = RQ.entry[index];
+                            MSHR.entry[mshr_index].pf_parked = prior_parked;
 
                             // Timeliness: mark this MSHR entry
                             MSHR.entry[mshr_index]
                                 .was_merged_with_prefetch_packet = true;
                             MSHR.entry[mshr_index].cycle_of_merge =
                                 current_core_cycle[read_cpu];
+                            MSHR.entry[mshr_index].merged_prefetch_priority =
+                                prior_priority;
 
                             // in case request is already returned, we should
                             // keep event_cycle and retunred variables
@@ -819,6 +858,7 @@ void CACHE::handle_read() {
 
                 if (miss_handled) {
                     // update prefetcher on load instruction
+                    PROFILE_SCOPE prefetcher_scope(prefetcher_profile_region());
                     if (RQ.entry[index].type == LOAD) {
                         if (cache_type == IS_L1I)
                             l1i_prefetcher_cache_operate(
@@ -839,6 +879,7 @@ void CACHE::handle_read() {
                             cpu = 0;
                         }
                     }
+                    prefetcher_scope.stop();
 
                     MISS[RQ.entry[index].type]++;
                     ACCESS[RQ.entry[index].type]++;
@@ -863,6 +904,9 @@ void CACHE::handle_prefetch() {
 
     for (uint32_t i = 0; i < MAX_READ; i++) {
 
+        if (cache_type == IS_L1D && PQ.occupancy > 1)
+            select_pq_head();
+
         uint32_t prefetch_cpu = PQ.entry[PQ.head].cpu;
         if (prefetch_cpu == NUM_CPUS)
             return;
@@ -883,7 +927,9 @@ void CACHE::handle_prefetch() {
                 if (cache_type == IS_LLC) {
                     llc_update_replacement_state(
                         prefetch_cpu, set, way, block[set][way].full_addr,
-                        PQ.entry[index].ip, 0, PQ.entry[index].type, 1);
+                        PQ.entry[index].ip, 0, PQ.entry[index].type, 1,
+                        PQ.entry[index].type == PREFETCH,
+                        pf_insertion_priority(PQ.entry[index]));
 
                 } else
                     update_replacement_state(
@@ -895,6 +941,7 @@ void CACHE::handle_prefetch() {
                 sim_access[prefetch_cpu][PQ.entry[index].type]++;
 
                 // run prefetcher on prefetches from higher caches
+                PROFILE_SCOPE prefetcher_scope(prefetcher_profile_region());
                 if (PQ.entry[index].pf_origin_level < fill_level) {
                     if (cache_type == IS_L1D)
                         l1d_prefetcher_operate(PQ.entry[index].full_addr,
@@ -913,6 +960,7 @@ void CACHE::handle_prefetch() {
                         cpu = 0;
                     }
                 }
+                prefetcher_scope.stop();
 
                 // check fill level
                 if (PQ.entry[index].fill_level < fill_level) {
@@ -963,6 +1011,24 @@ void CACHE::handle_prefetch() {
                     // this is a data/instruction collision in the MSHR, so we
                     // have to wait before we can allocate this miss
                     miss_handled = 0;
+                } else if ((mshr_index == -1) &&
+                           (PQ.entry[index].type == PREFETCH) &&
+                           (PQ.entry[index].fill_level <= fill_level) &&
+                           !mshr_quota_allows(PQ.entry[index].priority)) {
+                    // over its class's MSHR quota
+                    miss_handled = 0;
+                    if (PQ.entry[index].priority == 1 &&
+                        PQ.entry[index].fill_level < fill_level) {
+                        // an upper level waits for it, so it waits for a
+                        // slot, but the entries behind it go first
+                        STALL[PQ.entry[index].type]++;
+                        if (!skip_pq_head())
+                            return;
+                    } else {
+                        reject_prefetch(&PQ.entry[index]);
+                        PQ.remove_queue(&PQ.entry[index]);
+                        reads_available_this_cycle--;
+                    }
                 } else if ((mshr_index == -1) &&
                            (MSHR.occupancy < MSHR_SIZE)) { // this is a new miss
 
@@ -986,6 +1052,8 @@ void CACHE::handle_prefetch() {
 
                                 // run prefetcher on prefetches from higher
                                 // caches
+                                PROFILE_SCOPE prefetcher_scope(
+                                    prefetcher_profile_region());
                                 if (PQ.entry[index].pf_origin_level <
                                     fill_level) {
                                     if (cache_type == IS_LLC) {
@@ -999,6 +1067,7 @@ void CACHE::handle_prefetch() {
                                         cpu = 0;
                                     }
                                 }
+                                prefetcher_scope.stop();
 
                                 // add it to MSHRs if this prefetch miss will be
                                 // filled to this cache level
@@ -1018,6 +1087,8 @@ void CACHE::handle_prefetch() {
 
                                 // run prefetcher on prefetches from higher
                                 // caches
+                                PROFILE_SCOPE prefetcher_scope(
+                                    prefetcher_profile_region());
                                 if (PQ.entry[index].pf_origin_level <
                                     fill_level) {
                                     if (cache_type == IS_L1D)
@@ -1032,6 +1103,7 @@ void CACHE::handle_prefetch() {
                                                 PQ.entry[index].ip, 0, PREFETCH,
                                                 PQ.entry[index].pf_metadata);
                                 }
+                                prefetcher_scope.stop();
 
                                 // add it to MSHRs if this prefetch miss will be
                                 // filled to this cache level
@@ -1073,12 +1145,19 @@ void CACHE::handle_prefetch() {
                             MSHR.entry[mshr_index].fill_l1d = 1;
                         }
 
+                        if (PQ.entry[index].type == PREFETCH)
+                            pf_class_stats[PF_CLASS_MERGED]
+                                          [PQ.entry[index].priority]++;
+
                         // Also update priority if needed
                         if ((MSHR.entry[mshr_index].priority >
-                             PQ.entry[index].priority))
+                             PQ.entry[index].priority)) {
                             lower_level->increase_priority(
                                 &MSHR.entry[mshr_index],
                                 PQ.entry[index].priority);
+                            MSHR.entry[mshr_index].priority =
+                                PQ.entry[index].priority;
+                        }
 
                         MSHR_MERGED[PQ.entry[index].type]++;
 
@@ -1108,6 +1187,8 @@ void CACHE::handle_prefetch() {
 }
 
 void CACHE::operate() {
+    PROFILE_SCOPE operate_scope(profile_region());
+
     handle_fill();
     handle_writeback();
     reads_available_this_cycle = MAX_READ;
@@ -1115,6 +1196,18 @@ void CACHE::operate() {
 
     if (PQ.occupancy && (reads_available_this_cycle > 0))
         handle_prefetch();
+
+    if (!pq_overflow.empty())
+        refill_pq();
+
+    if (!nack_retry.empty())
+        retry_nacked_prefetches();
+
+    if (pf_wheel_occupancy)
+        release_parked_prefetches();
+
+    if ((current_core_cycle[cpu] % MSHR_OCCUPANCY_SAMPLE) == 0)
+        sample_mshr_occupancy();
 }
 
 uint32_t CACHE::get_set(uint64_t address) {
@@ -1130,6 +1223,27 @@ uint32_t CACHE::get_way(uint64_t address, uint32_t set) {
     return NUM_WAY;
 }
 
+/**
+ * evict_unused_prefetch - Account for the victim of a fill if it is a
+ * prefetch that was never used. Fill sites call it before the prefetcher's
+ * cache_fill hook, so the prefetcher has the report while it still tracks
+ * the victim's region.
+ */
+void CACHE::evict_unused_prefetch(uint32_t set, uint32_t way) {
+    if (block[set][way].prefetch && (block[set][way].used == 0)) {
+        pf_useless++;
+        pf_class_stats[PF_CLASS_USELESS][block[set][way].pf_priority]++;
+        pf_event_log.record(PF_EVENT_EVICT_UNUSED, cache_type,
+                            block[set][way].cpu, block[set][way].address,
+                            block[set][way].pf_priority,
+                            current_core_cycle[block[set][way].cpu] -
+                                block[set][way].cycle_prefetched);
+        if (report_timeliness_function)
+            report_timeliness_function(block[set][way].full_addr, 1000000,
+                                       current_core_cycle[block[set][way].cpu]);
+    }
+}
+
 void CACHE::fill_cache(uint32_t set, uint32_t way, PACKET *packet) {
 #ifdef SANITY_CHECK
     if (cache_type == IS_ITLB) {
@@ -1147,13 +1261,6 @@ void CACHE::fill_cache(uint32_t set, uint32_t way, PACKET *packet) {
             assert(0);
     }
 #endif
-    if (block[set][way].prefetch && (block[set][way].used == 0)) {
-        pf_useless++;
-        if (report_timeliness_function)
-            report_timeliness_function(block[set][way].full_addr, 1000000,
-                                       current_core_cycle[block[set][way].cpu]);
-    }
-
     if (block[set][way].valid == 0)
         block[set][way].valid = 1;
     block[set][way].dirty = 0;
@@ -1186,9 +1293,23 @@ void CACHE::fill_cache(uint32_t set, uint32_t way, PACKET *packet) {
     if (block[set][way].prefetch) {
         block[set][way].cycle_prefetched =
             current_core_cycle[block[set][way].cpu];
+        block[set][way].pf_priority = packet->priority;
+        block[set][way].pf_parked = packet->pf_parked;
+        pf_class_stats[PF_CLASS_FILLED][packet->priority]++;
+        pf_event_log.record(PF_EVENT_FILL, cache_type, packet->cpu,
+                            packet->address, packet->priority,
+                            packet->cycle_enqueued
+                                ? current_core_cycle[packet->cpu] -
+                                      packet->cycle_enqueued
+                                : 0);
     } else if (packet->was_merged_with_prefetch_packet) {
         int64_t timeliness = int64_t(packet->cycle_of_merge) -
                              int64_t(current_core_cycle[block[set][way].cpu]);
+        if (warmup_complete[packet->cpu])
+            pf_late_hist[packet->merged_prefetch_priority].record(-timeliness);
+        pf_class_stats[PF_CLASS_LATE][packet->merged_prefetch_priority]++;
+        record_pf_lead(packet->merged_prefetch_priority, packet->pf_parked,
+                       timeliness);
         if (report_timeliness_function) {
             report_timeliness_function(block[set][way].full_addr, timeliness,
                                        current_core_cycle[packet->cpu]);
@@ -1248,6 +1369,123 @@ int CACHE::invalidate_entry(uint64_t inval_addr) {
     return match_way;
 }
 
+// Update tags and replacement state as if the access had completed, without
+// queues, timing or statistics. Misses allocate and recurse to the lower
+// cache level; dirty victims are written back the same way. Prefetchers see
+// the same operate/fill calls as in detailed mode, so they train on
+// prefetches from upper levels only, and the prefetches they request are
+// applied functionally once the access is done.
+void CACHE::warm_access(uint64_t address, uint64_t full_addr, uint64_t ip,
+                        uint8_t type, uint64_t data, int pf_origin_level) {
+    CACHE *lower = (lower_level && cache_type != IS_LLC)
+                       ? static_cast<CACHE *>(lower_level)
+                       : NULL;
+    uint32_t set = get_set(address);
+    int way = -1;
+    for (uint32_t w = 0; w < NUM_WAY; w++) {
+        if (block[set][w].valid && (block[set][w].tag == address)) {
+            way = w;
+            break;
+        }
+    }
+    uint8_t hit = (way >= 0);
+
+    if (type == LOAD || (type == PREFETCH && pf_origin_level < fill_level)) {
+        if (cache_type == IS_L1I && type == LOAD)
+            l1i_prefetcher_cache_operate(cpu, ip, hit,
+                                         hit ? block[set][way].prefetch : 0);
+        else if (cache_type == IS_L1D)
+            l1d_prefetcher_operate(full_addr, ip, hit, type);
+        else if (cache_type == IS_L2C)
+            l2c_prefetcher_operate(address << LOG2_BLOCK_SIZE, ip, hit, type,
+                                   0);
+        else if (cache_type == IS_LLC)
+            llc_prefetcher_operate(address << LOG2_BLOCK_SIZE, ip, hit, type,
+                                   0);
+    }
+
+    if (!hit) {
+        if (lower && type != WRITEBACK)
+            lower->warm_access(address, full_addr, ip, type, data,
+                               pf_origin_level);
+
+        if (cache_type == IS_LLC)
+            way = llc_find_victim(cpu, 0, set, block[set], ip, full_addr, type);
+        else
+            way = find_victim(cpu, 0, set, block[set], ip, full_addr, type);
+
+        BLOCK &victim = block[set][way];
+        if (victim.valid && victim.dirty && lower)
+            lower->warm_access(victim.address, victim.full_addr, 0, WRITEBACK,
+                               victim.data);
+
+        uint64_t evicted = victim.address << LOG2_BLOCK_SIZE;
+        uint8_t prefetch = (type == PREFETCH);
+        if (cache_type == IS_L1I)
+            l1i_prefetcher_cache_fill(
+                cpu, (ip >> LOG2_BLOCK_SIZE) << LOG2_BLOCK_SIZE, set, way,
+                prefetch, (victim.ip >> LOG2_BLOCK_SIZE) << LOG2_BLOCK_SIZE);
+        else if (cache_type == IS_L1D)
+            l1d_prefetcher_cache_fill(full_addr, set, way, prefetch, evicted,
+                                      0);
+        else if (cache_type == IS_L2C)
+            l2c_prefetcher_cache_fill(address << LOG2_BLOCK_SIZE, set, way,
+                                      prefetch, evicted, 0);
+        else if (cache_type == IS_LLC)
+            llc_prefetcher_cache_fill(address << LOG2_BLOCK_SIZE, set, way,
+                                      prefetch, evicted, 0);
+    }
+
+    // warming does not carry prefetch priorities: insert at the default
+    if (cache_type == IS_LLC)
+        llc_update_replacement_state(cpu, set, way, full_addr, ip,
+                                     hit ? 0 : block[set][way].full_addr, type,
+                                     hit, type == PREFETCH, 2);
+    else
+        update_replacement_state(cpu, set, way, full_addr, ip,
+                                 hit ? 0 : block[set][way].full_addr, type,
+                                 hit);
+
+    BLOCK &b = block[set][way];
+    if (!hit) {
+        b.valid = 1;
+        b.dirty = 0;
+        b.prefetch = 0;
+        b.used = 0;
+        b.tag = address;
+        b.address = address;
+        b.full_addr = full_addr;
+        b.data = data;
+        b.ip = ip;
+        b.cpu = cpu;
+        b.instr_id = 0;
+    }
+    if (type == WRITEBACK || (type == RFO && cache_type == IS_L1D))
+        b.dirty = 1;
+
+    // apply the prefetches requested above, each at its fill level
+    vector<WARM_PREFETCH> requested;
+    requested.swap(warm_prefetches);
+    for (const WARM_PREFETCH &pf : requested) {
+        CACHE *target = this;
+        while (target->fill_level < pf.fill_level && target->lower_level &&
+               target->cache_type != IS_LLC)
+            target = static_cast<CACHE *>(target->lower_level);
+        target->warm_access(pf.full_addr >> LOG2_BLOCK_SIZE, pf.full_addr,
+                            pf.ip, PREFETCH, 0, fill_level);
+    }
+}
+
+int CACHE::queue_warm_prefetch(uint64_t ip, uint64_t base_addr,
+                               uint64_t pf_addr, int pf_fill_level) {
+    if ((base_addr >> LOG2_MAPPED_PAGE_SIZE) !=
+        (pf_addr >> LOG2_MAPPED_PAGE_SIZE))
+        return 0;
+
+    warm_prefetches.push_back({ip, pf_addr, pf_fill_level});
+    return 1;
+}
+
 int CACHE::add_rq(PACKET *packet) {
     // check for the latest wirtebacks in the write queue
     int wq_index = WQ.check_queue(packet);
@@ -1367,6 +1605,10 @@ int CACHE::add_rq(PACKET *packet) {
     if (RQ.tail >= RQ.SIZE)
         RQ.tail = 0;
 
+    if (packet->type == PREFETCH)
+        pf_event_log.record(PF_EVENT_ENQUEUE, cache_type, packet->cpu,
+                            packet->address, packet->priority, RQ.occupancy);
+
     if (packet->address == 0)
         assert(0);
 
@@ -1422,10 +1664,20 @@ int CACHE::add_wq(PACKET *packet) {
 
 int CACHE::prefetch_line(uint64_t ip, uint64_t base_addr, uint64_t pf_addr,
                          int pf_fill_level, uint32_t prefetch_metadata) {
+    if (functional_warming)
+        return queue_warm_prefetch(ip, base_addr, pf_addr, pf_fill_level);
+
     pf_requested++;
 
-    if (PQ.occupancy < PQ.SIZE) {
-        if ((base_addr >> LOG2_PAGE_SIZE) == (pf_addr >> LOG2_PAGE_SIZE)) {
+    if (pf_fill_level <= fill_level && !mshr_quota_allows(1)) {
+        pf_class_stats[PF_CLASS_REJECTED][1]++;
+        return 0;
+    }
+
+    if (pq_has_room(1)) {
+        // stay inside the physical page (2MB with -huge_pages)
+        if ((base_addr >> LOG2_MAPPED_PAGE_SIZE) ==
+            (pf_addr >> LOG2_MAPPED_PAGE_SIZE)) {
 
             PACKET pf_packet;
             pf_packet.fill_level = pf_fill_level;
@@ -1446,7 +1698,11 @@ int CACHE::prefetch_line(uint64_t ip, uint64_t base_addr, uint64_t pf_addr,
             pf_packet.event_cycle = current_core_cycle[cpu];
 
             pf_packet.priority = 1;
-            pf_stats[pf_packet.priority]++;
+            pf_class_stats[PF_CLASS_ISSUED][pf_packet.priority]++;
+
+            pf_event_log.record(PF_EVENT_ISSUE, cache_type, cpu,
+                                pf_packet.address, pf_packet.priority,
+                                pf_fill_level);
 
             // give a dummy 0 as the IP of a prefetch
             add_pq(&pf_packet);
@@ -1463,13 +1719,35 @@ int CACHE::prefetch_line(uint64_t ip, uint64_t base_addr, uint64_t pf_addr,
 // The BINGO version
 int CACHE::prefetch_line(uint64_t ip, uint64_t base_addr, uint64_t pf_addr,
                          int pf_fill_level, uint32_t prefetch_metadata,
-                         int priority) {
+                         int priority, uint8_t late) {
+    if (functional_warming)
+        return priority ? queue_warm_prefetch(ip, base_addr, pf_addr,
+                                              pf_fill_level)
+                        : 1;
+
     pf_requested++;
     if (priority == 0)
         return 1;
 
-    if (PQ.occupancy < PQ.SIZE) {
-        if ((base_addr >> LOG2_PAGE_SIZE) == (pf_addr >> LOG2_PAGE_SIZE)) {
+    if (pf_fill_level <= fill_level && !mshr_quota_allows(priority)) {
+        pf_class_stats[PF_CLASS_REJECTED][priority]++;
+        return 0;
+    }
+
+    // far-ahead prefetches wait on the wheel, see PF_WHEEL_SLOTS
+    if (priority == 3 && knob_jit_prefetch && cache_type == IS_L1D &&
+        (base_addr >> LOG2_MAPPED_PAGE_SIZE) ==
+            (pf_addr >> LOG2_MAPPED_PAGE_SIZE)) {
+        uint64_t delay = pf_wheel_delay();
+        if (delay) {
+            park_prefetch(ip, pf_addr, pf_fill_level, prefetch_metadata, delay);
+            return 1;
+        }
+    }
+
+    if (pq_has_room(priority)) {
+        if ((base_addr >> LOG2_MAPPED_PAGE_SIZE) ==
+            (pf_addr >> LOG2_MAPPED_PAGE_SIZE)) {
 
             PACKET pf_packet;
             pf_packet.fill_level = pf_fill_level;
@@ -1490,8 +1768,14 @@ int CACHE::prefetch_line(uint64_t ip, uint64_t base_addr, uint64_t pf_addr,
             pf_packet.event_cycle = current_core_cycle[cpu];
 
             pf_packet.priority = priority;
+            pf_packet.pf_rated = 1;
+            pf_packet.pf_late = late;
 
-            pf_stats[priority]++;
+            pf_class_stats[PF_CLASS_ISSUED][priority]++;
+
+            pf_event_log.record(PF_EVENT_ISSUE, cache_type, cpu,
+                                pf_packet.address, pf_packet.priority,
+                                pf_fill_level);
 
             // give a dummy 0 as the IP of a prefetch
             add_pq(&pf_packet);
@@ -1509,8 +1793,12 @@ int CACHE::kpc_prefetch_line(uint64_t base_addr, uint64_t pf_addr,
                              int pf_fill_level, int delta, int depth,
                              int signature, int confidence,
                              uint32_t prefetch_metadata) {
+    if (functional_warming)
+        return queue_warm_prefetch(0, base_addr, pf_addr, pf_fill_level);
+
     if (PQ.occupancy < PQ.SIZE) {
-        if ((base_addr >> LOG2_PAGE_SIZE) == (pf_addr >> LOG2_PAGE_SIZE)) {
+        if ((base_addr >> LOG2_MAPPED_PAGE_SIZE) ==
+            (pf_addr >> LOG2_MAPPED_PAGE_SIZE)) {
 
             PACKET pf_packet;
             pf_packet.fill_level = pf_fill_level;
@@ -1534,6 +1822,10 @@ int CACHE::kpc_prefetch_line(uint64_t base_addr, uint64_t pf_addr,
             pf_packet.confidence = confidence;
             pf_packet.event_cycle = current_core_cycle[cpu];
 
+            pf_event_log.record(PF_EVENT_ISSUE, cache_type, cpu,
+                                pf_packet.address, pf_packet.priority,
+                                pf_fill_level);
+
             // give a dummy 0 as the IP of a prefetch
             add_pq(&pf_packet);
 
@@ -1598,6 +1890,10 @@ int CACHE::add_pq(PACKET *packet) {
         if ((packet->fill_l1d) && (PQ.entry[index].fill_l1d != 1)) {
             PQ.entry[index].fill_l1d = 1;
         }
+        // the merged entry now answers the upper level too, so it must not
+        // be NACKed if that prefetch could not be
+        if (packet->priority < PQ.entry[index].priority)
+            PQ.entry[index].priority = packet->priority;
 
         PQ.MERGED++;
         PQ.ACCESS++;
@@ -1607,6 +1903,9 @@ int CACHE::add_pq(PACKET *packet) {
 
     // check occupancy
     if (PQ.occupancy == PQ_SIZE) {
+        if (cache_type == IS_L1D && packet->type == PREFETCH)
+            return add_pq_overflow(packet);
+
         PQ.FULL++;
 
         return -2; // cannot handle this request
@@ -1638,6 +1937,9 @@ int CACHE::add_pq(PACKET *packet) {
     if (PQ.tail >= PQ.SIZE)
         PQ.tail = 0;
 
+    pf_event_log.record(PF_EVENT_ENQUEUE, cache_type, packet->cpu,
+                        packet->address, packet->priority, PQ.occupancy);
+
     if (packet->address == 0)
         assert(0);
 
@@ -1768,13 +2070,22 @@ void CACHE::increment_WQ_FULL(uint64_t address) { WQ.FULL++; }
 void CACHE::increase_priority(PACKET *packet, uint8_t new_priority) {
     // First increment the priority of any requests in the PQs.
     int index = PQ.check_queue(packet);
-    if (index != -1 && PQ.entry[index].priority > new_priority)
+    if (index != -1 && PQ.entry[index].priority > new_priority) {
+        pf_event_log.record(PF_EVENT_PROMOTE, cache_type, PQ.entry[index].cpu,
+                            packet->address, new_priority,
+                            PQ.entry[index].priority);
+        pf_class_stats[PF_CLASS_PROMOTED][PQ.entry[index].priority]++;
         PQ.entry[index].priority = new_priority;
+    }
 
     // Do not return in either case; there could be an outstanding prefetch miss
     index = check_mshr(packet);
     if (index != -1 && MSHR.entry[index].priority > new_priority) {
         // We have such an outstanding miss
+        pf_event_log.record(PF_EVENT_PROMOTE, cache_type,
+                            MSHR.entry[index].cpu, packet->address,
+                            new_priority, MSHR.entry[index].priority);
+        pf_class_stats[PF_CLASS_PROMOTED][MSHR.entry[index].priority]++;
         MSHR.entry[index].priority = new_priority;
         // The same function name irrespective of whether the lower level is
         // DRAM
@@ -1782,6 +2093,394 @@ void CACHE::increase_priority(PACKET *packet, uint8_t new_priority) {
     }
 }
 
+/**
+ * nack_retry_origin - The cache that issued a prefetch of the given origin
+ * level, as seen from the LLC.
+ */
+CACHE *CACHE::nack_retry_origin(uint32_t cpu, int pf_origin_level) {
+    if (pf_origin_level == FILL_LLC)
+        return this;
+    CACHE *l2c = dynamic_cast<CACHE *>(upper_level_dcache[cpu]);
+    assert(l2c);
+    if (pf_origin_level == FILL_L2)
+        return l2c;
+    CACHE *l1d = dynamic_cast<CACHE *>(l2c->upper_level_dcache[cpu]);
+    assert(l1d);
+    return l1d;
+}
+
+/**
+ * buffer_nacked_prefetch - Keep a prefetch DRAM just NACKed for
+ * retry_nacked_prefetches, until the deadline its origin level's timeliness
+ * allows.
+ */
+void CACHE::buffer_nacked_prefetch(PACKET *packet) {
+    // only data prefetches: an L1I has no PQ to take them back
+    if (packet->type != PREFETCH || packet->instruction)
+        return;
+    for (uint32_t i = 0; i < nack_retry.size(); i++)
+        if (nack_retry[i].address == packet->address)
+            return;
+
+    CACHE *origin = nack_retry_origin(packet->cpu, packet->pf_origin_level);
+    const LOG_HISTOGRAM &used = origin->pf_timeliness_hist[3];
+    uint64_t window = (used.count >= NACK_RETRY_MIN_SAMPLES)
+                          ? used.percentile(0.5)
+                          : knob_nack_retry;
+
+    if (nack_retry.size() == NACK_RETRY_SIZE) {
+        nack_retry.pop_front();
+        nack_retry_overflow++;
+    }
+    NACK_RETRY_ENTRY entry;
+    entry.address = packet->address;
+    entry.full_addr = packet->full_addr;
+    entry.ip = packet->ip;
+    entry.deadline = current_core_cycle[packet->cpu] + window;
+    entry.cpu = packet->cpu;
+    entry.pf_metadata = packet->pf_metadata;
+    entry.fill_level = packet->fill_level;
+    entry.pf_origin_level = packet->pf_origin_level;
+    nack_retry.push_back(entry);
+    nack_retry_buffered++;
+}
+
+/**
+ * retry_nacked_prefetches - Drop expired entries and hand the oldest
+ * prefetch whose DRAM channel has gone quiet back to the PQ of the cache
+ * that issued it, at most one per cycle. The retry goes out at priority 2
+ * and has to pass that cache's admission checks like a new prefetch.
+ */
+void CACHE::retry_nacked_prefetches() {
+    for (uint32_t i = 0; i < nack_retry.size();) {
+        if (nack_retry[i].deadline <= current_core_cycle[nack_retry[i].cpu]) {
+            nack_retry.erase(nack_retry.begin() + i);
+            nack_retry_expired++;
+        } else
+            i++;
+    }
+
+    if (memory_pressure().level >= 2)
+        return;
+
+    for (uint32_t i = 0; i < nack_retry.size(); i++) {
+        NACK_RETRY_ENTRY &entry = nack_retry[i];
+        if (lower_level->get_occupancy(1, entry.address) >=
+            NACK_RETRY_WATERMARK)
+            continue;
+        CACHE *origin = nack_retry_origin(entry.cpu, entry.pf_origin_level);
+        if (!origin->admits_prefetch(entry.fill_level, 2))
+            continue;
+
+        PACKET pf_packet;
+        pf_packet.fill_level = entry.fill_level;
+        pf_packet.pf_origin_level = entry.pf_origin_level;
+        if (entry.fill_level == FILL_L1)
+            pf_packet.fill_l1d = 1;
+        pf_packet.pf_metadata = entry.pf_metadata;
+        pf_packet.cpu = entry.cpu;
+        pf_packet.address = entry.address;
+        pf_packet.full_addr = entry.full_addr;
+        pf_packet.ip = entry.ip;
+        pf_packet.type = PREFETCH;
+        pf_packet.event_cycle = current_core_cycle[entry.cpu];
+        pf_packet.priority = 2;
+        pf_packet.pf_rated = 1;
+
+        pf_event_log.record(PF_EVENT_ISSUE, origin->cache_type, entry.cpu,
+                            pf_packet.address, pf_packet.priority,
+                            entry.fill_level);
+        origin->add_pq(&pf_packet);
+
+        nack_retry.erase(nack_retry.begin() + i);
+        nack_retry_reissued++;
+        return;
+    }
+}
+
+/**
+ * mshr_quota_allows - Whether a prefetch of this priority may take an MSHR
+ * entry under the quotas, see MSHR_OCCUPANCY_SAMPLE.
+ */
+bool CACHE::mshr_quota_allows(uint8_t priority) {
+    if (mshr_quota[priority] >= MSHR_SIZE)
+        return true;
+
+    uint32_t held = 0;
+    for (uint32_t i = 0; i < MSHR_SIZE; i++)
+        if (MSHR.entry[i].address && MSHR.entry[i].type == PREFETCH &&
+            MSHR.entry[i].priority >= priority)
+            held++;
+    return held < mshr_quota[priority];
+}
+
+/**
+ * skip_pq_head - Swap the oldest ready PQ entry behind the head into the
+ * head slot, past a priority-1 prefetch for an upper level that waits for
+ * an MSHR quota slot. Such prefetches wait too and are passed over; false
+ * if no entry is left.
+ */
+bool CACHE::skip_pq_head() {
+    for (uint32_t i = 1, index = (PQ.head + 1) % PQ.SIZE; i < PQ.occupancy;
+         i++, index = (index + 1) % PQ.SIZE) {
+        if (PQ.entry[index].event_cycle >
+            current_core_cycle[PQ.entry[index].cpu])
+            continue;
+        if (PQ.entry[index].priority == 1 &&
+            PQ.entry[index].fill_level < fill_level)
+            continue;
+        swap(PQ.entry[index], PQ.entry[PQ.head]);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * reject_prefetch - Account for a prefetch dropped over its MSHR quota and
+ * free the upper-level MSHR entries waiting for it, as a DRAM NACK would.
+ */
+void CACHE::reject_prefetch(PACKET *packet) {
+    pf_class_stats[PF_CLASS_REJECTED][packet->priority]++;
+    if (packet->fill_level >= fill_level)
+        return;
+    if (cache_type == IS_LLC)
+        upper_level_dcache[packet->cpu]->nack_request(packet);
+    else if (cache_type == IS_L2C) {
+        upper_level_dcache[packet->cpu]->nack_request(packet);
+        upper_level_icache[packet->cpu]->nack_request(packet);
+    }
+}
+
+void CACHE::sample_mshr_occupancy() {
+    for (uint32_t i = 0; i < MSHR_SIZE; i++)
+        if (MSHR.entry[i].address)
+            mshr_occupancy[MSHR.entry[i].type == PREFETCH
+                               ? MSHR.entry[i].priority
+                               : 0]++;
+    mshr_occupancy_samples++;
+}
+
+// true if a outranks b in the L1D PQ: higher priority, then older
+static bool pq_outranks(const PACKET &a, const PACKET &b) {
+    if (a.priority != b.priority)
+        return a.priority < b.priority;
+    return a.event_cycle < b.event_cycle;
+}
+
+/**
+ * pq_has_room - Whether the PQ would take a prefetch of this priority: it
+ * has a free slot, or, at the L1D, holds a lower-priority entry to displace.
+ */
+bool CACHE::pq_has_room(uint8_t priority) {
+    if (PQ.occupancy < PQ.SIZE)
+        return true;
+    if (cache_type != IS_L1D)
+        return false;
+    for (uint32_t i = 0; i < PQ.SIZE; i++)
+        if (PQ.entry[i].priority > priority)
+            return true;
+    return false;
+}
+
+/**
+ * admits_prefetch - Whether a prefetch of this priority filling
+ * pf_fill_level may enter the PQ: it needs room there and, if it will take
+ * an MSHR entry of this cache, a free one under the quotas.
+ */
+bool CACHE::admits_prefetch(int pf_fill_level, uint8_t priority) {
+    if (pf_fill_level <= fill_level && !mshr_quota_allows(priority))
+        return false;
+    return pq_has_room(priority);
+}
+
+/**
+ * add_pq_overflow - Take a prefetch at a full L1D PQ, see PQ_OVERFLOW_SIZE.
+ */
+int CACHE::add_pq_overflow(PACKET *packet) {
+    for (uint32_t i = 0; i < pq_overflow.size(); i++)
+        if (pq_overflow[i].address == packet->address) {
+            if (packet->fill_level < pq_overflow[i].fill_level)
+                pq_overflow[i].fill_level = packet->fill_level;
+            if (packet->fill_l1d)
+                pq_overflow[i].fill_l1d = 1;
+            if (packet->priority < pq_overflow[i].priority)
+                pq_overflow[i].priority = packet->priority;
+            PQ.MERGED++;
+            PQ.ACCESS++;
+            return -1;
+        }
+
+    // the arrival displaces the PQ's lowest-priority, youngest entry
+    uint32_t worst = PQ.head;
+    for (uint32_t i = 0, index = PQ.head; i < PQ.occupancy;
+         i++, index = (index + 1) % PQ.SIZE)
+        if (pq_outranks(PQ.entry[worst], PQ.entry[index]))
+            worst = index;
+    if (PQ.entry[worst].priority <= packet->priority) {
+        PQ.FULL++;
+        return -2;
+    }
+
+    PACKET spill = PQ.entry[worst];
+    PQ.entry[worst] = *packet;
+    PQ.entry[worst].event_cycle = current_core_cycle[cpu] + LATENCY;
+    pf_event_log.record(PF_EVENT_ENQUEUE, cache_type, packet->cpu,
+                        packet->address, packet->priority, PQ.occupancy);
+    PQ.TO_CACHE++;
+
+    if (pq_overflow.size() == PQ_OVERFLOW_SIZE) {
+        uint32_t victim = 0;
+        for (uint32_t i = 1; i < pq_overflow.size(); i++)
+            if (pq_outranks(pq_overflow[victim], pq_overflow[i]))
+                victim = i;
+        if (pq_outranks(spill, pq_overflow[victim]))
+            swap(spill, pq_overflow[victim]);
+        pf_class_stats[PF_CLASS_DROPPED][spill.priority]++;
+        PQ.FULL++;
+    } else
+        pq_overflow.push_back(spill);
+
+    PQ.ACCESS++;
+    return -1;
+}
+
+/**
+ * select_pq_head - Swap the ready PQ entry of the highest priority, oldest
+ * first, into the head slot that handle_prefetch serves.
+ */
+void CACHE::select_pq_head() {
+    uint32_t best = PQ.SIZE;
+    for (uint32_t i = 0, index = PQ.head; i < PQ.occupancy;
+         i++, index = (index + 1) % PQ.SIZE) {
+        if (PQ.entry[index].event_cycle > current_core_cycle[cpu])
+            continue;
+        if (best == PQ.SIZE || pq_outranks(PQ.entry[index], PQ.entry[best]))
+            best = index;
+    }
+    if (best != PQ.SIZE && best != PQ.head)
+        swap(PQ.entry[best], PQ.entry[PQ.head]);
+}
+
+/**
+ * refill_pq - Move the best prefetches of the L1D overflow buffer into the
+ * free PQ slots.
+ */
+void CACHE::refill_pq() {
+    while (PQ.occupancy < PQ.SIZE && !pq_overflow.empty()) {
+        uint32_t best = 0;
+        for (uint32_t i = 1; i < pq_overflow.size(); i++)
+            if (pq_outranks(pq_overflow[i], pq_overflow[best]))
+                best = i;
+        PACKET packet = pq_overflow[best];
+        pq_overflow.erase(pq_overflow.begin() + best);
+        add_pq(&packet);
+    }
+}
+
+/**
+ * pf_wheel_delay - Cycles to park a priority-3 prefetch for, 0 to issue it
+ * right away.
+ */
+uint64_t CACHE::pf_wheel_delay() {
+    if (pf_wheel_occupancy == PF_WHEEL_SIZE ||
+        pf_wheel_lead_hist.count < PF_WHEEL_MIN_SAMPLES)
+        return 0;
+
+    uint64_t lead = pf_wheel_lead_hist.percentile(0.5);
+    if (lead <= knob_jit_prefetch)
+        return 0;
+    return min(lead - knob_jit_prefetch,
+               (uint64_t)(PF_WHEEL_SLOTS - 1) << PF_WHEEL_GRAIN_LOG2);
+}
+
+void CACHE::park_prefetch(uint64_t ip, uint64_t pf_addr, int pf_fill_level,
+                          uint32_t prefetch_metadata, uint64_t delay) {
+    uint64_t now = current_core_cycle[cpu] >> PF_WHEEL_GRAIN_LOG2;
+    // release_parked_prefetches only runs while something is parked
+    if (pf_wheel_occupancy == 0)
+        pf_wheel_tick = now;
+
+    // never lap the slot being released
+    uint64_t tick = (current_core_cycle[cpu] + delay) >> PF_WHEEL_GRAIN_LOG2;
+    tick = max(tick, now + 1);
+    tick = min(tick, pf_wheel_tick + PF_WHEEL_SLOTS - 1);
+
+    PF_WHEEL_ENTRY entry;
+    entry.ip = ip;
+    entry.full_addr = pf_addr;
+    entry.parked_cycle = current_core_cycle[cpu];
+    entry.pf_metadata = prefetch_metadata;
+    entry.fill_level = pf_fill_level;
+    pf_wheel[tick % PF_WHEEL_SLOTS].push_back(entry);
+    pf_wheel_occupancy++;
+    pf_wheel_parked++;
+}
+
+/**
+ * release_parked_prefetches - Move the prefetches whose slot has come up
+ * into the PQ, at priority 2. Blocks that arrived meanwhile are dropped;
+ * a prefetch the PQ or MSHR quota would not admit stays parked with the
+ * rest of its slot until the next cycle.
+ */
+void CACHE::release_parked_prefetches() {
+    uint64_t now = current_core_cycle[cpu] >> PF_WHEEL_GRAIN_LOG2;
+    for (; pf_wheel_tick <= now; pf_wheel_tick++) {
+        std::vector<PF_WHEEL_ENTRY> &slot =
+            pf_wheel[pf_wheel_tick % PF_WHEEL_SLOTS];
+        while (!slot.empty()) {
+            if (!admits_prefetch(slot.back().fill_level, 2))
+                return;
+
+            PF_WHEEL_ENTRY entry = slot.back();
+            slot.pop_back();
+            pf_wheel_occupancy--;
+
+            PACKET pf_packet;
+            pf_packet.fill_level = entry.fill_level;
+            pf_packet.pf_origin_level = fill_level;
+            if (entry.fill_level == FILL_L1)
+                pf_packet.fill_l1d = 1;
+            pf_packet.pf_metadata = entry.pf_metadata;
+            pf_packet.cpu = cpu;
+            pf_packet.address = entry.full_addr >> LOG2_BLOCK_SIZE;
+            pf_packet.full_addr = entry.full_addr;
+            pf_packet.ip = entry.ip;
+            pf_packet.type = PREFETCH;
+            pf_packet.event_cycle = current_core_cycle[cpu];
+            pf_packet.priority = 2;
+            pf_packet.pf_rated = 1;
+            pf_packet.pf_parked = current_core_cycle[cpu] - entry.parked_cycle;
+
+            if (check_hit(&pf_packet) != -1) {
+                pf_wheel_dropped++;
+                continue;
+            }
+
+            pf_class_stats[PF_CLASS_ISSUED][pf_packet.priority]++;
+            pf_event_log.record(PF_EVENT_ISSUE, cache_type, cpu,
+                                pf_packet.address, pf_packet.priority,
+                                entry.fill_level);
+            add_pq(&pf_packet);
+            pf_issued++;
+            pf_wheel_released++;
+        }
+    }
+}
+
+/**
+ * record_pf_lead - Learn the lead of a priority-3 or parked prefetch: the
+ * cycles from fill to its first use (negative if the demand caught it in
+ * flight) plus the cycles it was parked.
+ */
+void CACHE::record_pf_lead(uint8_t pf_priority, uint64_t pf_parked,
+                           int64_t timeliness) {
+    if (!knob_jit_prefetch || cache_type != IS_L1D ||
+        (pf_priority != 3 && pf_parked == 0))
+        return;
+    int64_t lead = timeliness + (int64_t)pf_parked;
+    pf_wheel_lead_hist.record(lead > 0 ? lead : 0);
+}
+
 /**
  * nack_request - For prefetches that are marked with priority 3 (lowest), the
  * DRAM controller is free to refuse servicing them. In such a case, the
@@ -1796,10 +2495,16 @@ void CACHE::nack_request(PACKET *packet) {
         if (MSHR.entry[index].address == packet->address) {
             found = true;
             xcpu = MSHR.entry[index].cpu;
-            // Mark free
-            MSHR.entry[index].address = 0;
+            pf_event_log.record(PF_EVENT_NACK, cache_type, xcpu,
+                                packet->address, MSHR.entry[index].priority,
+                                0);
+            pf_class_stats[PF_CLASS_NACKED][MSHR.entry[index].priority]++;
             // At most one entry exists in the MSHR for any address
             xfill_level = MSHR.entry[index].fill_level;
+            if (cache_type == IS_LLC && knob_nack_retry)
+                buffer_nacked_prefetch(&MSHR.entry[index]);
+            // Free the entry
+            MSHR.remove_queue(&MSHR.entry[index]);
             break;
         }
     }
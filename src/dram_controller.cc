@@ -1,4 +1,6 @@
 #include "dram_controller.h"
+#include "pf_event_log.h"
+#include "profiler.h"
 
 extern int l1d_prefetch_hit_at[4], dram_reads;
 
@@ -63,8 +65,12 @@ void MEMORY_CONTROLLER::reset_remain_requests(PACKET_QUEUE *queue,
 }
 
 void MEMORY_CONTROLLER::operate() {
+    PROFILE_SCOPE operate_scope(PROF_DRAM);
+
     // if (all_warmup_complete >= NUM_CPUS)
     //    log_file << RQ[0].occupancy << '\n';
+    update_pressure();
+
     // First things first: retry outstanding promotions *before* taking
     // any scheduling or processing decisions.
     retry_outstanding_promotions();
@@ -273,6 +279,8 @@ restart:
             // Reject the request and try again
             upper_level_dcache[queue->entry[oldest_index].cpu]->nack_request(
                 &queue->entry[oldest_index]);
+            num_nacks++;
+            priority_stats[DRAM_PRIORITY_NACKED][3]++;
             queue->entry[oldest_index].address = 0;
             queue->occupancy--;
             update_schedule_cycle(&RQ[read_channel]);
@@ -288,7 +296,16 @@ restart:
                     break;
             LOWER_PRIORITY_RQ[read_channel].entry[index] =
                 RQ[read_channel].entry[oldest_index];
+            LOWER_PRIORITY_RQ[read_channel].entry[index].dram_demote_cycle =
+                current_core_cycle[queue->entry[oldest_index].cpu];
             LOWER_PRIORITY_RQ[read_channel].occupancy++;
+            num_demotions++;
+            priority_stats[DRAM_PRIORITY_DEMOTED][2]++;
+            pf_event_log.record(PF_EVENT_DEMOTE, PF_EVENT_LEVEL_DRAM,
+                                LOWER_PRIORITY_RQ[read_channel].entry[index].cpu,
+                                LOWER_PRIORITY_RQ[read_channel].entry[index].address,
+                                LOWER_PRIORITY_RQ[read_channel].entry[index].priority,
+                                queue->occupancy);
             queue->entry[oldest_index].address = 0;
             queue->occupancy--;
             update_schedule_cycle(&RQ[read_channel]);
@@ -343,6 +360,15 @@ restart:
         queue->entry[oldest_index].event_cycle =
             current_core_cycle[op_cpu] + LATENCY;
 
+        queue->entry[oldest_index].dram_schedule_cycle =
+            current_core_cycle[op_cpu];
+        if (queue->entry[oldest_index].dram_demote_cycle) {
+            lower_rq_residency_hist[queue->entry[oldest_index].priority].record(
+                current_core_cycle[op_cpu] -
+                queue->entry[oldest_index].dram_demote_cycle);
+            queue->entry[oldest_index].dram_demote_cycle = 0;
+        }
+
         update_schedule_cycle(queue);
         update_process_cycle(queue);
     }
@@ -372,6 +398,7 @@ void MEMORY_CONTROLLER::process(PACKET_QUEUE *queue) {
                 // update data bus cycle time
                 dbus_cycle_available[op_channel] =
                     current_core_cycle[op_cpu] + DRAM_DBUS_RETURN_TIME;
+                dbus_busy_cycles[op_channel] += DRAM_DBUS_RETURN_TIME;
 
                 if (bank_request[op_channel][op_rank][op_bank].row_buffer_hit)
                     queue->ROW_BUFFER_HIT++;
@@ -390,17 +417,36 @@ void MEMORY_CONTROLLER::process(PACKET_QUEUE *queue) {
                 // update data bus cycle time
                 dbus_cycle_available[op_channel] =
                     current_core_cycle[op_cpu] + DRAM_DBUS_RETURN_TIME;
+                dbus_busy_cycles[op_channel] += DRAM_DBUS_RETURN_TIME;
                 queue->entry[request_index].event_cycle =
                     dbus_cycle_available[op_channel];
 
+                PACKET &op = queue->entry[request_index];
+                if (op.dram_enqueue_cycle) {
+                    queueing_delay_hist[op.type][op.priority].record(
+                        op.dram_schedule_cycle - op.dram_enqueue_cycle);
+                    service_time_hist[op.type][op.priority].record(
+                        dbus_cycle_available[op_channel] -
+                        op.dram_schedule_cycle);
+                }
+
                 // send data back to the core cache hierarchy
                 upper_level_dcache[op_cpu]->return_data(
                     &queue->entry[request_index]);
 
-                if (bank_request[op_channel][op_rank][op_bank].row_buffer_hit)
+                if (bank_request[op_channel][op_rank][op_bank].row_buffer_hit) {
                     queue->ROW_BUFFER_HIT++;
-                else
+                    if (op.type == PREFETCH)
+                        priority_stats[DRAM_PRIORITY_ROW_HIT][op.priority]++;
+                    else
+                        demand_row_hits++;
+                } else {
                     queue->ROW_BUFFER_MISS++;
+                    if (op.type == PREFETCH)
+                        priority_stats[DRAM_PRIORITY_ROW_MISS][op.priority]++;
+                    else
+                        demand_row_misses++;
+                }
 
                 // this bank is ready for another DRAM request
                 bank_request[op_channel][op_rank][op_bank].request_index = -1;
@@ -475,6 +521,12 @@ int MEMORY_CONTROLLER::add_rq(PACKET *packet) {
     if (index != -1)
         return index; // merged index
 
+    packet->dram_enqueue_cycle = current_core_cycle[packet->cpu];
+    if (packet->type == PREFETCH)
+        pf_event_log.record(PF_EVENT_ENQUEUE, PF_EVENT_LEVEL_DRAM, packet->cpu,
+                            packet->address, packet->priority,
+                            RQ[channel].occupancy);
+
     // search for the empty index
     bool found_empty = false;
     int index_priority_2 = -1, index_priority_3 = -1;
@@ -484,7 +536,9 @@ int MEMORY_CONTROLLER::add_rq(PACKET *packet) {
             RQ[channel].entry[index] = *packet;
             RQ[channel].occupancy++;
             break;
-        } else if (RQ[channel].entry[index].priority == 3)
+        } else if (RQ[channel].entry[index].scheduled)
+            continue; // a bank is working on it
+        else if (RQ[channel].entry[index].priority == 3)
             index_priority_3 = index;
         else if (RQ[channel].entry[index].priority == 2)
             index_priority_2 = index;
@@ -508,7 +562,9 @@ int MEMORY_CONTROLLER::add_rq(PACKET *packet) {
             // LLC.
             upper_level_dcache[RQ[channel].entry[index_priority_3].cpu]
                 ->nack_request(&RQ[channel].entry[index_priority_3]);
-            RQ[channel].entry[index] = *packet;
+            num_nacks++;
+            priority_stats[DRAM_PRIORITY_NACKED][3]++;
+            RQ[channel].entry[index_priority_3] = *packet;
             update_schedule_cycle(&RQ[channel]);
         } else {
             // We must have (2) holding here.
@@ -516,16 +572,24 @@ int MEMORY_CONTROLLER::add_rq(PACKET *packet) {
             // queue and replace it with the incoming packet. We should update
             // the schedule cycles of both queues.
             for (index = 0; index < int(LOWER_PRIORITY_RQ[channel].SIZE);
-                 index++) {
-                if (LOWER_PRIORITY_RQ[channel].entry[index].address == 0) {
-                    LOWER_PRIORITY_RQ[channel].entry[index] = *packet;
-                    LOWER_PRIORITY_RQ[channel].occupancy++;
+                 index++)
+                if (LOWER_PRIORITY_RQ[channel].entry[index].address == 0)
                     break;
-                }
-            }
+            // check_availability_for_priority_read promised a free slot
+            assert(index_priority_2 != -1 &&
+                   index < int(LOWER_PRIORITY_RQ[channel].SIZE));
             LOWER_PRIORITY_RQ[channel].entry[index] =
                 RQ[channel].entry[index_priority_2];
+            LOWER_PRIORITY_RQ[channel].entry[index].dram_demote_cycle =
+                current_core_cycle[packet->cpu];
             LOWER_PRIORITY_RQ[channel].occupancy++;
+            num_demotions++;
+            priority_stats[DRAM_PRIORITY_DEMOTED][2]++;
+            pf_event_log.record(PF_EVENT_DEMOTE, PF_EVENT_LEVEL_DRAM,
+                                LOWER_PRIORITY_RQ[channel].entry[index].cpu,
+                                LOWER_PRIORITY_RQ[channel].entry[index].address,
+                                LOWER_PRIORITY_RQ[channel].entry[index].priority,
+                                RQ[channel].occupancy);
             RQ[channel].entry[index_priority_2] = *packet;
             update_schedule_cycle(&RQ[channel]);
             update_schedule_cycle(&LOWER_PRIORITY_RQ[channel]);
@@ -678,6 +742,49 @@ void MEMORY_CONTROLLER::increment_WQ_FULL(uint64_t address) {
     WQ[channel].FULL++;
 }
 
+static uint8_t pressure_level(float value, float low, float mid, float high) {
+    return (value >= high) ? 3 : (value >= mid) ? 2 : (value >= low) ? 1 : 0;
+}
+
+/**
+ * update_pressure - Sample the read queues every cycle and, at the end of
+ * each MEMORY_PRESSURE_WINDOW, publish the window's read queue fill, data
+ * bus utilization and NACK rate. The level is the highest any of the three
+ * reaches: a saturated bus, a backed-up read queue or frequent NACKs each
+ * mean that further prefetches mostly delay demands.
+ */
+void MEMORY_CONTROLLER::update_pressure() {
+    for (uint32_t i = 0; i < DRAM_CHANNELS; i++)
+        pressure_rq_occupancy += RQ[i].occupancy;
+
+    uint64_t cycles = current_core_cycle[0] - pressure_window_start;
+    if (cycles < MEMORY_PRESSURE_WINDOW)
+        return;
+
+    uint64_t busy = 0;
+    for (uint32_t i = 0; i < DRAM_CHANNELS; i++)
+        busy += dbus_busy_cycles[i];
+    uint64_t reads = dram_reads - pressure_reads_start,
+             nacks = num_nacks - pressure_nacks_start;
+
+    pressure.rq_fill = (float)pressure_rq_occupancy /
+                       (cycles * DRAM_CHANNELS * DRAM_RQ_SIZE);
+    pressure.bus_util = min(
+        1.0f, (float)(busy - pressure_busy_start) / (cycles * DRAM_CHANNELS));
+    pressure.nack_rate = reads ? (float)nacks / reads : 0;
+    pressure.level =
+        max(pressure_level(pressure.bus_util, 0.6, 0.8, 0.95),
+            max(pressure_level(pressure.rq_fill, 0.25, 0.5, 0.75),
+                pressure_level(pressure.nack_rate, 0.01, 0.05, 0.2)));
+    pressure_windows[pressure.level]++;
+
+    pressure_window_start = current_core_cycle[0];
+    pressure_rq_occupancy = 0;
+    pressure_busy_start = busy;
+    pressure_reads_start = dram_reads;
+    pressure_nacks_start = num_nacks;
+}
+
 /**
  * check_availability_for_priority_load - Check whether we can accept a read
  * request of priority `priority`.
@@ -705,7 +812,10 @@ bool MEMORY_CONTROLLER::check_availability_for_priority_read(uint64_t address,
     // AB: Should we have a separate occupancy value for each priority class
     // as well? That way we won't need this loop.
     bool have_a_2 = false, have_a_3 = false;
+    // only requests no bank has started on can make room
     for (int index = 0; index < DRAM_RQ_SIZE; index++) {
+        if (RQ[channel].entry[index].scheduled)
+            continue;
         if (RQ[channel].entry[index].priority == 3) {
             have_a_3 = true;
             // No need to check 2's
@@ -748,11 +858,18 @@ void MEMORY_CONTROLLER::increase_priority_by_index(uint32_t channel, int index,
         // Fill in the entry from the lower queue, but mark the increased
         // priority.
         RQ[channel].entry[free_index] = LOWER_PRIORITY_RQ[channel].entry[index];
+        PACKET &promoted = RQ[channel].entry[free_index];
+        if (promoted.dram_demote_cycle) {
+            lower_rq_residency_hist[promoted.priority].record(
+                current_core_cycle[promoted.cpu] - promoted.dram_demote_cycle);
+            promoted.dram_demote_cycle = 0;
+        }
         RQ[channel].entry[free_index].priority = new_priority;
         RQ[channel].occupancy++;
 
-        // Erase the entry from the lower priority queue
-        LOWER_PRIORITY_RQ[channel].entry[index].address = 0;
+        // Erase the entry from the lower priority queue. Clear all of it: a
+        // stale scheduled bit would get the empty slot processed.
+        LOWER_PRIORITY_RQ[channel].entry[index] = PACKET();
         LOWER_PRIORITY_RQ[channel].occupancy--;
 
         // We changed the contents of both the queues. We should update either
@@ -780,7 +897,8 @@ void MEMORY_CONTROLLER::increase_priority_by_index(uint32_t channel, int index,
         // has enough free space before calling the function. Else, this line
         // below will mess up the iteration used by the calling function, and
         // may lead to duplicates in the outstanding queue.
-        pending_promotions[channel].push(std::make_pair(index, new_priority));
+        pending_promotions[channel].push(std::make_pair(
+            LOWER_PRIORITY_RQ[channel].entry[index].address, new_priority));
     }
 }
 
@@ -796,10 +914,16 @@ void MEMORY_CONTROLLER::retry_outstanding_promotions() {
             if (RQ[channel].occupancy >= DRAM_RQ_SIZE)
                 break;
 
-            // We have enough space: promote this.
-            pair<int, uint8_t> p = pending_promotions[channel].front();
+            // We have enough space: promote this, if it is still waiting.
+            pair<uint64_t, uint8_t> p = pending_promotions[channel].front();
             pending_promotions[channel].pop();
-            increase_priority_by_index(channel, p.first, p.second, true);
+            for (uint32_t index = 0; index < LOWER_PRIORITY_RQ[channel].SIZE;
+                 index++)
+                if (LOWER_PRIORITY_RQ[channel].entry[index].address ==
+                    p.first) {
+                    increase_priority_by_index(channel, index, p.second, true);
+                    break;
+                }
         }
     }
 }
@@ -845,7 +969,14 @@ void MEMORY_CONTROLLER::increase_priority(PACKET *packet,
     }
 
     // This will also take care of cases where the main queue is full
-    if (index != -1)
+    if (index != -1) {
+        num_promotions++;
+        PACKET &old = low_prio_queue ? LOWER_PRIORITY_RQ[channel].entry[index]
+                                     : RQ[channel].entry[index];
+        pf_event_log.record(PF_EVENT_PROMOTE, PF_EVENT_LEVEL_DRAM, old.cpu,
+                            old.address, new_priority, old.priority);
+        priority_stats[DRAM_PRIORITY_PROMOTED][old.priority]++;
         increase_priority_by_index(channel, index, new_priority,
                                    low_prio_queue);
+    }
 }
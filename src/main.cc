@@ -1,9 +1,15 @@
 #define _BSD_SOURCE
 
+#include <chrono>
 #include <fstream>
 #include <getopt.h>
+#include <sys/resource.h>
 
 #include "ooo_cpu.h"
+#include "pf_event_log.h"
+#include "sampler.h"
+#include "smarts.h"
+#include "trace_shm.h"
 #include "uncore.h"
 
 uint8_t warmup_complete[NUM_CPUS], simulation_complete[NUM_CPUS],
@@ -15,6 +21,19 @@ uint32_t knob_low_bandwidth = 3200;
 uint64_t warmup_instructions = 1000000, simulation_instructions = 10000000,
          champsim_seed;
 
+// interval sampler, disabled unless an interval is given
+uint64_t knob_sample_interval = 0;
+string knob_sample_file = "champsim_samples.bin";
+
+// prefetch lifecycle event log, disabled unless a path is given
+string knob_pf_event_log;
+
+uint8_t knob_profile = 0;
+
+// interval sharding: start this far into the trace, warming functionally
+// over the instructions just before the start
+uint64_t knob_skip_instructions = 0, knob_functional_warmup = 0;
+
 time_t start_time;
 
 int l1d_prefetch_hit_at[4] = {0};
@@ -22,12 +41,29 @@ int dram_reads = 0;
 
 // PAGE TABLE
 uint32_t PAGE_TABLE_LATENCY = 0, SWAP_LATENCY = 0;
-queue<uint64_t> page_queue;
-map<uint64_t, uint64_t> page_table, inverse_table, recent_page,
-    unique_cl[NUM_CPUS];
+ADDR_MAP page_table, inverse_table, unique_cl[NUM_CPUS];
+vector<uint64_t> clock_vkeys;
+uint64_t clock_hand = 0;
+uint8_t knob_huge_pages = 0;
+uint64_t knob_nack_retry = 0;
+uint64_t knob_jit_prefetch = 0;
+uint32_t LOG2_MAPPED_PAGE_SIZE = LOG2_PAGE_SIZE;
 uint64_t previous_ppage, num_adjacent_page, num_cl[NUM_CPUS], allocated_pages,
     num_page[NUM_CPUS], minor_fault[NUM_CPUS], major_fault[NUM_CPUS];
 
+// only called when something is printed, so the main loop never pays for
+// the time() syscall
+void print_simulation_time() {
+    uint64_t elapsed_second = (uint64_t)(time(NULL) - start_time),
+             elapsed_minute = elapsed_second / 60,
+             elapsed_hour = elapsed_minute / 60;
+    elapsed_minute -= elapsed_hour * 60;
+    elapsed_second -= (elapsed_hour * 3600 + elapsed_minute * 60);
+
+    cout << " (Simulation time: " << elapsed_hour << " hr " << elapsed_minute
+         << " min " << elapsed_second << " sec) " << endl;
+}
+
 void record_roi_stats(uint32_t cpu, CACHE *cache) {
     for (uint32_t i = 0; i < NUM_TYPES; i++) {
         cache->roi_access[cpu][i] = cache->sim_access[cpu][i];
@@ -128,11 +164,13 @@ void print_branch_stats() {
                     ooo_cpu[i].num_branch;
         cout << "% MPKI: "
              << (1000.0 * ooo_cpu[i].branch_mispredictions) /
-                    (ooo_cpu[i].num_retired - ooo_cpu[i].warmup_instructions);
+                    (ooo_cpu[i].num_retired - ooo_cpu[i].begin_sim_instr);
         cout << " Average ROB Occupancy at Mispredict: "
              << (1.0 * ooo_cpu[i].total_rob_occupancy_at_branch_mispredict) /
                     ooo_cpu[i].branch_mispredictions
-             << endl
+             << endl;
+        cout << "CPU " << i << " Branches: " << ooo_cpu[i].num_branch
+             << " Mispredictions: " << ooo_cpu[i].branch_mispredictions << endl
              << endl;
 
         cout << "Branch types" << endl;
@@ -205,6 +243,206 @@ void print_dram_stats() {
              << endl;
     else
         cout << " AVG_CONGESTED_CYCLE: -" << endl;
+
+    cout << " PRESSURE_WINDOWS";
+    for (uint32_t i = 0; i < MEMORY_PRESSURE_LEVELS; i++)
+        cout << "  L" << i << ": " << setw(10)
+             << uncore.DRAM.pressure_windows[i];
+    cout << endl;
+
+    if (knob_nack_retry)
+        cout << " NACK_RETRY BUFFERED: " << setw(10)
+             << uncore.LLC.nack_retry_buffered << "  REISSUED: " << setw(10)
+             << uncore.LLC.nack_retry_reissued << "  EXPIRED: " << setw(10)
+             << uncore.LLC.nack_retry_expired << "  OVERFLOW: " << setw(10)
+             << uncore.LLC.nack_retry_overflow << endl;
+}
+
+const string type_names[NUM_TYPES] = {"LOAD", "RFO", "PREFETCH",
+                                      "WRITEBACK"};
+
+const string pf_class_names[NUM_PF_CLASS_STATS] = {
+    "ISSUED", "MERGED", "NACKED",  "PROMOTED", "FILLED",
+    "USEFUL", "LATE",   "USELESS", "DROPPED",  "REJECTED"};
+
+void print_cache_priority_classes(CACHE *cache) {
+    for (uint32_t j = 0; j < 4; j++) {
+        uint64_t total = 0;
+        for (uint32_t i = 0; i < NUM_PF_CLASS_STATS; i++)
+            total += cache->pf_class_stats[i][j];
+        if (total == 0)
+            continue;
+
+        cout << cache->NAME << " P" << j;
+        for (uint32_t i = 0; i < NUM_PF_CLASS_STATS; i++)
+            cout << "  " << pf_class_names[i] << ": " << setw(10)
+                 << cache->pf_class_stats[i][j];
+        cout << endl;
+    }
+}
+
+// average MSHR entries held by demands and by each prefetch priority
+void print_cache_mshr_occupancy(CACHE *cache) {
+    if (cache->mshr_occupancy_samples == 0)
+        return;
+
+    cout << cache->NAME << " MSHR_OCCUPANCY";
+    for (uint32_t j = 0; j < 4; j++) {
+        if (j == 0)
+            cout << "  DEMAND: ";
+        else
+            cout << "  P" << j << ": ";
+        cout << setw(10)
+             << (double)cache->mshr_occupancy[j] /
+                    cache->mshr_occupancy_samples;
+    }
+    cout << "  QUOTA:";
+    for (uint32_t j = 1; j < 4; j++)
+        cout << " " << cache->mshr_quota[j];
+    cout << " / " << cache->MSHR_SIZE << endl;
+}
+
+// Apply one -mshr_quota spec, [L1D:|L2C:|LLC:]<p1>,<p2>,<p3>, in percent
+// of each MSHR; without a level it applies to all three
+void set_mshr_quota(const char *spec) {
+    uint32_t level = 0, percent[4] = {100, 100, 100, 100};
+    if (strncmp(spec, "L1D:", 4) == 0)
+        level = IS_L1D;
+    else if (strncmp(spec, "L2C:", 4) == 0)
+        level = IS_L2C;
+    else if (strncmp(spec, "LLC:", 4) == 0)
+        level = IS_LLC;
+    if (level)
+        spec += 4;
+    if (sscanf(spec, "%u,%u,%u", &percent[1], &percent[2], &percent[3]) !=
+            3 ||
+        percent[1] > 100 || percent[2] > 100 || percent[3] > 100) {
+        cerr << "-mshr_quota takes [L1D:|L2C:|LLC:]<p1>,<p2>,<p3> in percent"
+             << endl;
+        assert(0);
+    }
+
+    vector<CACHE *> caches;
+    for (uint32_t i = 0; i < NUM_CPUS; i++) {
+        if (level == 0 || level == IS_L1D)
+            caches.push_back(&ooo_cpu[i].L1D);
+        if (level == 0 || level == IS_L2C)
+            caches.push_back(&ooo_cpu[i].L2C);
+    }
+    if (level == 0 || level == IS_LLC)
+        caches.push_back(&uncore.LLC);
+
+    for (CACHE *cache : caches) {
+        for (uint32_t j = 1; j < 4; j++)
+            cache->mshr_quota[j] = cache->MSHR_SIZE * percent[j] / 100;
+        cout << "MSHR Quota " << cache->NAME << ":";
+        for (uint32_t j = 1; j < 4; j++)
+            cout << " P" << j << " " << cache->mshr_quota[j];
+        cout << " of " << cache->MSHR_SIZE << endl;
+    }
+}
+
+// Prefetches by PACKET::priority at every level: what happened to them in
+// the caches, and how DRAM treated the reads of each class
+void print_priority_class_stats() {
+    cout << endl;
+    cout << "Prefetch Priority Classes" << endl;
+    for (uint32_t i = 0; i < NUM_CPUS; i++) {
+        print_cache_priority_classes(&ooo_cpu[i].L1D);
+        print_cache_priority_classes(&ooo_cpu[i].L1I);
+        print_cache_priority_classes(&ooo_cpu[i].L2C);
+    }
+    print_cache_priority_classes(&uncore.LLC);
+
+    for (uint32_t i = 0; i < NUM_CPUS; i++) {
+        print_cache_mshr_occupancy(&ooo_cpu[i].L1D);
+        print_cache_mshr_occupancy(&ooo_cpu[i].L2C);
+    }
+    print_cache_mshr_occupancy(&uncore.LLC);
+
+    if (knob_jit_prefetch)
+        for (uint32_t i = 0; i < NUM_CPUS; i++) {
+            CACHE &l1d = ooo_cpu[i].L1D;
+            cout << l1d.NAME << " JIT_PREFETCH PARKED: " << setw(10)
+                 << l1d.pf_wheel_parked << "  RELEASED: " << setw(10)
+                 << l1d.pf_wheel_released << "  DROPPED: " << setw(10)
+                 << l1d.pf_wheel_dropped << "  MEDIAN_LEAD: " << setw(10)
+                 << l1d.pf_wheel_lead_hist.percentile(0.5) << endl;
+        }
+
+    // demands go out at priority 1 and would swamp the prefetches there, so
+    // the priority rows cover prefetch reads only
+    uint64_t hits = uncore.DRAM.demand_row_hits,
+             misses = uncore.DRAM.demand_row_misses, queued = 0, queueing = 0;
+    for (uint32_t i = 0; i < NUM_TYPES; i++) {
+        if (i == PREFETCH)
+            continue;
+        for (uint32_t j = 0; j < 4; j++) {
+            queued += uncore.DRAM.queueing_delay_hist[i][j].count;
+            queueing += uncore.DRAM.queueing_delay_hist[i][j].sum;
+        }
+    }
+    if (hits + misses)
+        cout << "DRAM DEMAND  ROW_BUFFER_HIT_RATE: " << setw(10)
+             << (100.0 * hits) / (hits + misses) << "%"
+             << "  AVG_QUEUEING: " << setw(10)
+             << (queued ? (1.0 * queueing) / queued : 0) << endl;
+
+    for (uint32_t j = 0; j < 4; j++) {
+        hits = uncore.DRAM.priority_stats[DRAM_PRIORITY_ROW_HIT][j];
+        misses = uncore.DRAM.priority_stats[DRAM_PRIORITY_ROW_MISS][j];
+        uint64_t events = 0;
+        for (uint32_t i = 0; i < NUM_DRAM_PRIORITY_STATS; i++)
+            events += uncore.DRAM.priority_stats[i][j];
+        if (events == 0)
+            continue;
+
+        cout << "DRAM P" << j << "  DEMOTED: " << setw(10)
+             << uncore.DRAM.priority_stats[DRAM_PRIORITY_DEMOTED][j]
+             << "  NACKED: " << setw(10)
+             << uncore.DRAM.priority_stats[DRAM_PRIORITY_NACKED][j]
+             << "  PROMOTED: " << setw(10)
+             << uncore.DRAM.priority_stats[DRAM_PRIORITY_PROMOTED][j]
+             << "  ROW_BUFFER_HIT_RATE: " << setw(10)
+             << (hits + misses ? (100.0 * hits) / (hits + misses) : 0) << "%"
+             << "  AVG_QUEUEING: " << setw(10)
+             << uncore.DRAM.queueing_delay_hist[PREFETCH][j].mean() << endl;
+    }
+}
+
+void print_cache_histograms(CACHE *cache) {
+    for (uint32_t i = 0; i < NUM_TYPES; i++)
+        for (uint32_t j = 0; j < 4; j++)
+            cache->miss_latency_hist[i][j].print(
+                cache->NAME + " " + type_names[i] + " P" + to_string(j) +
+                " MISS_LATENCY");
+    for (uint32_t j = 0; j < 4; j++)
+        cache->pf_timeliness_hist[j].print(cache->NAME + " PREFETCH P" +
+                                           to_string(j) + " TIMELINESS");
+    for (uint32_t j = 0; j < 4; j++)
+        cache->pf_late_hist[j].print(cache->NAME + " PREFETCH P" +
+                                     to_string(j) + " LATE_BY");
+}
+
+void print_latency_histograms() {
+    cout << endl;
+    cout << "Latency Histograms (cycles)" << endl;
+    for (uint32_t i = 0; i < NUM_CPUS; i++) {
+        print_cache_histograms(&ooo_cpu[i].L1D);
+        print_cache_histograms(&ooo_cpu[i].L1I);
+        print_cache_histograms(&ooo_cpu[i].L2C);
+    }
+    print_cache_histograms(&uncore.LLC);
+
+    for (uint32_t i = 0; i < NUM_TYPES; i++)
+        for (uint32_t j = 0; j < 4; j++) {
+            string label = "DRAM " + type_names[i] + " P" + to_string(j);
+            uncore.DRAM.queueing_delay_hist[i][j].print(label + " QUEUEING");
+            uncore.DRAM.service_time_hist[i][j].print(label + " SERVICE");
+        }
+    for (uint32_t j = 0; j < 4; j++)
+        uncore.DRAM.lower_rq_residency_hist[j].print(
+            "DRAM P" + to_string(j) + " LOWER_RQ_RESIDENCY");
 }
 
 void reset_cache_stats(uint32_t cpu, CACHE *cache) {
@@ -222,11 +460,27 @@ void reset_cache_stats(uint32_t cpu, CACHE *cache) {
 
     cache->total_miss_latency = 0;
 
+    for (uint32_t i = 0; i < 4; i++) {
+        for (uint32_t j = 0; j < NUM_TYPES; j++)
+            cache->miss_latency_hist[j][i].reset();
+        cache->pf_timeliness_hist[i].reset();
+        cache->pf_late_hist[i].reset();
+    }
+
     cache->pf_requested = 0;
     cache->pf_issued = 0;
     cache->pf_useful = 0;
     cache->pf_useless = 0;
     cache->pf_fill = 0;
+    for (uint32_t i = 0; i < NUM_PF_CLASS_STATS; i++)
+        for (uint32_t j = 0; j < 4; j++)
+            cache->pf_class_stats[i][j] = 0;
+    cache->pf_wheel_parked = 0;
+    cache->pf_wheel_released = 0;
+    cache->pf_wheel_dropped = 0;
+    for (uint32_t i = 0; i < 4; i++)
+        cache->mshr_occupancy[i] = 0;
+    cache->mshr_occupancy_samples = 0;
 
     cache->RQ.ACCESS = 0;
     cache->RQ.MERGED = 0;
@@ -267,6 +521,7 @@ void finish_warmup() {
 
         ooo_cpu[i].begin_sim_cycle = current_core_cycle[i];
         ooo_cpu[i].begin_sim_instr = ooo_cpu[i].num_retired;
+        ooo_cpu[i].begin_sim_position = ooo_cpu[i].trace_position();
 
         // reset branch stats
         ooo_cpu[i].num_branch = 0;
@@ -291,6 +546,32 @@ void finish_warmup() {
         uncore.DRAM.WQ[i].ROW_BUFFER_HIT = 0;
         uncore.DRAM.WQ[i].ROW_BUFFER_MISS = 0;
     }
+    for (uint32_t i = 0; i < MEMORY_PRESSURE_LEVELS; i++)
+        uncore.DRAM.pressure_windows[i] = 0;
+    uncore.LLC.nack_retry_buffered = 0;
+    uncore.LLC.nack_retry_reissued = 0;
+    uncore.LLC.nack_retry_expired = 0;
+    uncore.LLC.nack_retry_overflow = 0;
+    for (uint32_t i = 0; i < NUM_DRAM_PRIORITY_STATS; i++)
+        for (uint32_t j = 0; j < 4; j++)
+            uncore.DRAM.priority_stats[i][j] = 0;
+    uncore.DRAM.demand_row_hits = 0;
+    uncore.DRAM.demand_row_misses = 0;
+    for (uint32_t i = 0; i < 4; i++) {
+        for (uint32_t j = 0; j < NUM_TYPES; j++) {
+            uncore.DRAM.queueing_delay_hist[j][i].reset();
+            uncore.DRAM.service_time_hist[j][i].reset();
+        }
+        uncore.DRAM.lower_rq_residency_hist[i].reset();
+    }
+
+    // time series covers the region of interest only
+    if (knob_sample_interval)
+        sampler.start(knob_sample_file.c_str(), knob_sample_interval);
+    if (!knob_pf_event_log.empty())
+        pf_event_log.open(knob_pf_event_log.c_str());
+    if (smarts.enabled)
+        smarts.start();
 
     // set actual cache latency
     for (uint32_t i = 0; i < NUM_CPUS; i++) {
@@ -409,87 +690,95 @@ uint64_t va_to_pa(uint32_t cpu, uint64_t instr_id, uint64_t va,
     // smart random number generator
     uint64_t random_ppage;
 
-    map<uint64_t, uint64_t>::iterator pr = page_table.begin();
-    map<uint64_t, uint64_t>::iterator ppage_check = inverse_table.begin();
-
-    // check unique cache line footprint
-    map<uint64_t, uint64_t>::iterator cl_check =
-        unique_cl[cpu].find(unique_va >> LOG2_BLOCK_SIZE);
-    if (cl_check ==
-        unique_cl[cpu].end()) { // we've never seen this cache line before
-        unique_cl[cpu].insert(make_pair(unique_va >> LOG2_BLOCK_SIZE, 0));
+    // check unique cache line footprint: one bit per line of each page
+    uint64_t &lines = unique_cl[cpu][unique_va >> LOG2_PAGE_SIZE],
+             line_bit = 1ULL << ((unique_va >> LOG2_BLOCK_SIZE) &
+                                 ((1 << (LOG2_PAGE_SIZE - LOG2_BLOCK_SIZE)) -
+                                  1));
+    if ((lines & line_bit) == 0) { // we've never seen this cache line before
+        lines |= line_bit;
         num_cl[cpu]++;
-    } else
-        cl_check->second++;
+    }
 
-    pr = page_table.find(vpage);
-    if (pr == page_table.end()) { // no VA => PA translation found
+    // with huge pages one mapping covers a whole 2MB region: the page table
+    // is keyed by the region and the 4KB page picks the page in the frame
+    uint32_t map_shift = LOG2_MAPPED_PAGE_SIZE - LOG2_PAGE_SIZE;
+    uint64_t vkey = vpage,
+             page_in_frame =
+                 (unique_va >> LOG2_PAGE_SIZE) & ((1ULL << map_shift) - 1);
+    if (map_shift) {
+        vkey = unique_va >> LOG2_MAPPED_PAGE_SIZE;
+        if (knob_cloudsuite) // keep the address space id
+            vkey = (vkey << 9) | (vpage & 0x1FF);
+    }
 
-        if (allocated_pages >= DRAM_PAGES) { // not enough memory
+    uint64_t *mapped = page_table.find(vkey);
+    if (mapped == NULL) { // no VA => PA translation found
 
-            // TODO: elaborate page replacement algorithm
-            // here, ChampSim randomly selects a page that is not recently used
-            // and we only track 32K recently accessed pages
-            uint8_t found_NRU = 0;
-            uint64_t NRU_vpage = 0; // implement it
-            map<uint64_t, uint64_t>::iterator pr2 = recent_page.begin();
-            for (pr = page_table.begin(); pr != page_table.end(); pr++) {
+        // not enough memory
+        if (allocated_pages >= ((uint64_t)DRAM_PAGES >> map_shift)) {
 
-                NRU_vpage = pr->first;
-                if (recent_page.find(NRU_vpage) == recent_page.end()) {
-                    found_NRU = 1;
+            // CLOCK replacement: sweep the mappings in allocation order,
+            // giving referenced ones a second chance
+            uint64_t *victim;
+            while (1) {
+                victim = page_table.find(clock_vkeys[clock_hand]);
+#ifdef SANITY_CHECK
+                if (victim == NULL)
+                    assert(0);
+#endif
+                if ((*victim & PAGE_REFERENCED) == 0)
                     break;
-                }
+                *victim &= ~PAGE_REFERENCED;
+                clock_hand = (clock_hand + 1) % clock_vkeys.size();
             }
-#ifdef SANITY_CHECK
-            if (found_NRU == 0)
-                assert(0);
+            uint64_t NRU_vkey = clock_vkeys[clock_hand],
+                     mapped_frame = *victim;
 
-            if (pr == page_table.end())
-                assert(0);
-#endif
             DP(if (warmup_complete[cpu]) {
-                cout << "[SWAP] update page table NRU_vpage: " << hex
-                     << pr->first << " new_vpage: " << vpage
-                     << " ppage: " << pr->second << dec << endl;
+                cout << "[SWAP] update page table NRU_vkey: " << hex
+                     << NRU_vkey << " new_vkey: " << vkey
+                     << " frame: " << mapped_frame << dec << endl;
             });
 
             // update page table with new VA => PA mapping
-            // since we cannot change the key value already inserted in a map
-            // structure, we need to erase the old node and add a new node
-            uint64_t mapped_ppage = pr->second;
-            page_table.erase(pr);
-            page_table.insert(make_pair(vpage, mapped_ppage));
+            page_table.erase(NRU_vkey);
+            page_table[vkey] = mapped_frame;
+            clock_vkeys[clock_hand] = vkey;
+            clock_hand = (clock_hand + 1) % clock_vkeys.size();
 
             // update inverse table with new PA => VA mapping
-            ppage_check = inverse_table.find(mapped_ppage);
+            uint64_t *ppage_check = inverse_table.find(mapped_frame);
 #ifdef SANITY_CHECK
-            if (ppage_check == inverse_table.end())
+            if (ppage_check == NULL)
                 assert(0);
 #endif
-            ppage_check->second = vpage;
-
-            DP(if (warmup_complete[cpu]) {
-                cout << "[SWAP] update inverse table NRU_vpage: " << hex
-                     << NRU_vpage << " new_vpage: ";
-                cout << ppage_check->second << " ppage: " << ppage_check->first
-                     << dec << endl;
-            });
-
-            // update page_queue
-            page_queue.pop();
-            page_queue.push(vpage);
-
-            // invalidate corresponding vpage and ppage from the cache hierarchy
-            ooo_cpu[cpu].ITLB.invalidate_entry(NRU_vpage);
-            ooo_cpu[cpu].DTLB.invalidate_entry(NRU_vpage);
-            ooo_cpu[cpu].STLB.invalidate_entry(NRU_vpage);
-            for (uint32_t i = 0; i < BLOCK_SIZE; i++) {
-                uint64_t cl_addr = (mapped_ppage << 6) | i;
-                ooo_cpu[cpu].L1I.invalidate_entry(cl_addr);
-                ooo_cpu[cpu].L1D.invalidate_entry(cl_addr);
-                ooo_cpu[cpu].L2C.invalidate_entry(cl_addr);
-                uncore.LLC.invalidate_entry(cl_addr);
+            *ppage_check = vkey;
+
+            // invalidate corresponding vpages and ppages from the cache
+            // hierarchy
+            for (uint64_t p = 0; p < (1ULL << map_shift); p++) {
+                uint64_t NRU_vpage = NRU_vkey,
+                         mapped_ppage = (mapped_frame << map_shift) | p;
+                if (map_shift)
+                    NRU_vpage =
+                        knob_cloudsuite
+                            ? ((((NRU_vkey >> 9) << map_shift) | p) << 9) |
+                                  (NRU_vkey & 0x1FF)
+                            : (NRU_vkey << map_shift) | p;
+
+                ooo_cpu[cpu].ITLB.invalidate_entry(NRU_vpage);
+                ooo_cpu[cpu].DTLB.invalidate_entry(NRU_vpage);
+                ooo_cpu[cpu].STLB.invalidate_entry(NRU_vpage);
+                for (uint32_t i = 0; i < PAGE_SIZE / BLOCK_SIZE; i++) {
+                    uint64_t cl_addr =
+                        (mapped_ppage << (LOG2_PAGE_SIZE - LOG2_BLOCK_SIZE)) |
+                        i;
+                    ooo_cpu[cpu].L1I.invalidate_entry(cl_addr);
+                    ooo_cpu[cpu].L1D.invalidate_entry(cl_addr);
+                    ooo_cpu[cpu].L2C.invalidate_entry(cl_addr);
+                    uncore.LLC.invalidate_entry(cl_addr);
+                }
             }
 
             // swap complete
@@ -499,7 +788,7 @@ uint64_t va_to_pa(uint32_t cpu, uint64_t instr_id, uint64_t va,
             if (num_adjacent_page > 0)
                 random_ppage = ++previous_ppage;
             else {
-                random_ppage = champsim_rand.draw_rand();
+                random_ppage = champsim_rand.draw_rand() >> map_shift;
                 fragmented = 1;
             }
 
@@ -511,12 +800,11 @@ uint64_t va_to_pa(uint32_t cpu, uint64_t instr_id, uint64_t va,
             // (cpu<<(32-LOG2_PAGE_SIZE));
 
             while (1) { // try to find an empty physical page number
-                ppage_check = inverse_table.find(
+                uint64_t *ppage_check = inverse_table.find(
                     random_ppage); // check if this page can be allocated
-                if (ppage_check !=
-                    inverse_table.end()) { // random_ppage is not available
+                if (ppage_check != NULL) { // random_ppage is not available
                     DP(if (warmup_complete[cpu]) {
-                        cout << "vpage: " << hex << ppage_check->first
+                        cout << "vpage: " << hex << *ppage_check
                              << " is already mapped to ppage: " << random_ppage
                              << dec << endl;
                     });
@@ -525,7 +813,7 @@ uint64_t va_to_pa(uint32_t cpu, uint64_t instr_id, uint64_t va,
                         fragmented = 1;
 
                     // try one more time
-                    random_ppage = champsim_rand.draw_rand();
+                    random_ppage = champsim_rand.draw_rand() >> map_shift;
 
                     // encoding cpu number
                     // random_ppage &= (~((NUM_CPUS-1)<<(32-LOG2_PAGE_SIZE)));
@@ -537,9 +825,9 @@ uint64_t va_to_pa(uint32_t cpu, uint64_t instr_id, uint64_t va,
             // insert translation to page tables
             // printf("Insert  num_adjacent_page: %u  vpage: %lx  ppage: %lx\n",
             // num_adjacent_page, vpage, random_ppage);
-            page_table.insert(make_pair(vpage, random_ppage));
-            inverse_table.insert(make_pair(random_ppage, vpage));
-            page_queue.push(vpage);
+            page_table[vkey] = random_ppage;
+            inverse_table[random_ppage] = vkey;
+            clock_vkeys.push_back(vkey);
             previous_ppage = random_ppage;
             num_adjacent_page--;
             num_page[cpu]++;
@@ -559,16 +847,21 @@ uint64_t va_to_pa(uint32_t cpu, uint64_t instr_id, uint64_t va,
             major_fault[cpu]++;
         else
             minor_fault[cpu]++;
+
+        mapped = page_table.find(vkey);
     } else {
-        // printf("Found  vpage: %lx  random_ppage: %lx\n", vpage, pr->second);
+        // printf("Found  vpage: %lx  random_ppage: %lx\n", vpage, *mapped);
     }
 
-    pr = page_table.find(vpage);
 #ifdef SANITY_CHECK
-    if (pr == page_table.end())
+    if (mapped == NULL)
         assert(0);
 #endif
-    uint64_t ppage = pr->second;
+    // every translation sets the reference bit for CLOCK: data pages come
+    // through here on STLB misses, code pages on every instruction fetch
+    *mapped |= PAGE_REFERENCED;
+    uint64_t ppage =
+        ((*mapped & ~PAGE_REFERENCED) << map_shift) | page_in_frame;
 
     uint64_t pa = ppage << LOG2_PAGE_SIZE;
     pa |= voffset;
@@ -635,6 +928,20 @@ int main(int argc, char **argv) {
             {"hide_heartbeat", no_argument, 0, 'h'},
             {"cloudsuite", no_argument, 0, 'c'},
             {"low_bandwidth", required_argument, 0, 'b'},
+            {"sample_interval", required_argument, 0, 's'},
+            {"sample_file", required_argument, 0, 'f'},
+            {"pf_event_log", required_argument, 0, 'e'},
+            {"profile", no_argument, 0, 'p'},
+            {"smarts_period", required_argument, 0, 'P'},
+            {"smarts_window", required_argument, 0, 'W'},
+            {"smarts_warmup", required_argument, 0, 'D'},
+            {"smarts_error", required_argument, 0, 'E'},
+            {"skip_instructions", required_argument, 0, 'k'},
+            {"functional_warmup", required_argument, 0, 'F'},
+            {"huge_pages", no_argument, 0, 'H'},
+            {"nack_retry", required_argument, 0, 'N'},
+            {"jit_prefetch", required_argument, 0, 'J'},
+            {"mshr_quota", required_argument, 0, 'Q'},
             {"traces", no_argument, 0, 't'},
             {0, 0, 0, 0}};
 
@@ -665,6 +972,51 @@ int main(int argc, char **argv) {
         case 'b':
             knob_low_bandwidth = atol(optarg);
             break;
+        case 's':
+            knob_sample_interval = atol(optarg);
+            break;
+        case 'f':
+            knob_sample_file = optarg;
+            break;
+        case 'e':
+            knob_pf_event_log = optarg;
+            break;
+        case 'p':
+            knob_profile = 1;
+            profiler.enabled = 1;
+            break;
+        case 'P':
+            smarts.period = atol(optarg);
+            smarts.enabled = (smarts.period > 0);
+            break;
+        case 'W':
+            smarts.window = atol(optarg);
+            break;
+        case 'D':
+            smarts.detailed_warmup = atol(optarg);
+            break;
+        case 'E':
+            smarts.target_error = atof(optarg);
+            break;
+        case 'k':
+            knob_skip_instructions = atol(optarg);
+            break;
+        case 'F':
+            knob_functional_warmup = atol(optarg);
+            break;
+        case 'H':
+            knob_huge_pages = 1;
+            LOG2_MAPPED_PAGE_SIZE = LOG2_HUGE_PAGE_SIZE;
+            break;
+        case 'N':
+            knob_nack_retry = atol(optarg);
+            break;
+        case 'J':
+            knob_jit_prefetch = atol(optarg);
+            break;
+        case 'Q':
+            set_mshr_quota(optarg);
+            break;
         case 't':
             traces_encountered = 1;
             break;
@@ -682,6 +1034,31 @@ int main(int argc, char **argv) {
     // cout << "Scramble Loads: " << (knob_scramble_loads ? "ture" : "false") <<
     // endl;
     cout << "Number of CPUs: " << NUM_CPUS << endl;
+    if (knob_sample_interval)
+        cout << "Sample Interval: " << knob_sample_interval
+             << " cycles -> " << knob_sample_file << endl;
+    if (!knob_pf_event_log.empty())
+        cout << "Prefetch Event Log: " << knob_pf_event_log << endl;
+    if (knob_skip_instructions || knob_functional_warmup)
+        cout << "Skip Instructions: " << knob_skip_instructions
+             << " Functional Warmup Instructions: " << knob_functional_warmup
+             << endl;
+    if (knob_huge_pages)
+        cout << "Huge Pages: " << (1 << (LOG2_HUGE_PAGE_SIZE - 20))
+             << "MB mappings" << endl;
+    if (knob_nack_retry)
+        cout << "NACK Retry Deadline: " << knob_nack_retry
+             << " cycles without a timeliness estimate" << endl;
+    if (knob_jit_prefetch)
+        cout << "Just-in-time L1D Prefetch Margin: " << knob_jit_prefetch
+             << " cycles" << endl;
+    if (smarts.enabled) {
+        cout << "SMARTS Sampling Period: " << smarts.period << endl;
+        if (NUM_CPUS > 1) {
+            cerr << "SMARTS sampling supports a single core only" << endl;
+            assert(0);
+        }
+    }
     cout << "LLC sets: " << LLC_SET << endl;
     cout << "LLC ways: " << LLC_WAY << endl;
 
@@ -717,6 +1094,12 @@ int main(int argc, char **argv) {
         if (found_traces) {
             printf("CPU %d runs %s\n", count_traces, argv[i]);
 
+            // read the trace from a trace_server ring instead of
+            // decompressing it here
+            uint8_t shm_trace = (strncmp(argv[i], "shm:", 4) == 0);
+            if (shm_trace)
+                argv[i] += 4;
+
             sprintf(ooo_cpu[count_traces].trace_string, "%s", argv[i]);
 
             std::string full_name(argv[i]);
@@ -778,10 +1161,21 @@ int main(int argc, char **argv) {
                 j++;
             }
 
-            ooo_cpu[count_traces].trace_file =
-                popen(ooo_cpu[count_traces].gunzip_command, "r");
+            ooo_cpu[count_traces].trace_shm = shm_trace;
+            if (shm_trace)
+                ooo_cpu[count_traces].trace_file =
+                    trace_shm_open(ooo_cpu[count_traces].trace_string,
+                                   ooo_cpu[count_traces].gunzip_command);
+            else
+                ooo_cpu[count_traces].trace_file =
+                    popen(ooo_cpu[count_traces].gunzip_command, "r");
             if (ooo_cpu[count_traces].trace_file == NULL) {
-                printf("\n*** Trace file not found: %s ***\n\n", argv[i]);
+                if (shm_trace)
+                    printf("\n*** No trace server is serving %s ***\n\n",
+                           ooo_cpu[count_traces].trace_string);
+                else
+                    printf("\n*** Trace file not found: %s ***\n\n",
+                           argv[i]);
                 assert(0);
             }
 
@@ -909,16 +1303,35 @@ int main(int argc, char **argv) {
     uncore.LLC.llc_initialize_replacement();
     uncore.LLC.llc_prefetcher_initialize();
 
+    // seek to the shard's interval and warm up functionally; the detailed
+    // warmup then starts after the functionally warmed instructions
+    if (knob_skip_instructions || knob_functional_warmup) {
+        uint64_t warmed = 0;
+        for (int i = 0; i < NUM_CPUS; i++) {
+            ooo_cpu[i].skip_trace(knob_skip_instructions);
+            warmed = max(warmed,
+                         ooo_cpu[i].functional_warm(knob_functional_warmup));
+        }
+        warmup_instructions += warmed;
+        for (int i = 0; i < NUM_CPUS; i++) {
+            ooo_cpu[i].warmup_instructions = warmup_instructions;
+            ooo_cpu[i].begin_sim_instr = warmup_instructions;
+        }
+    }
+
+    // sampled simulation warms up functionally
+    if (smarts.enabled)
+        smarts.fast_forward_warmup(warmup_instructions + 1);
+
     // simulation entry point
     start_time = time(NULL);
+    std::chrono::steady_clock::time_point wall_start =
+        std::chrono::steady_clock::now();
     uint8_t run_simulation = 1;
     while (run_simulation) {
 
-        uint64_t elapsed_second = (uint64_t)(time(NULL) - start_time),
-                 elapsed_minute = elapsed_second / 60,
-                 elapsed_hour = elapsed_minute / 60;
-        elapsed_minute -= elapsed_hour * 60;
-        elapsed_second -= (elapsed_hour * 3600 + elapsed_minute * 60);
+        profiler.next_cycle();
+        PROFILE_SCOPE cycle_scope(PROF_CYCLE_OTHER);
 
         for (int i = 0; i < NUM_CPUS; i++) {
             // proceed one cycle
@@ -937,41 +1350,44 @@ int main(int argc, char **argv) {
                      COMPLETED) &&
                     (ooo_cpu[i].ROB.entry[ooo_cpu[i].ROB.head].event_cycle <=
                      current_core_cycle[i]))
-                    ooo_cpu[i].retire_rob();
+                    PROFILE_CALL(PROF_RETIRE, ooo_cpu[i].retire_rob());
 
                 // complete
-                ooo_cpu[i].update_rob();
+                PROFILE_CALL(PROF_UPDATE_ROB, ooo_cpu[i].update_rob());
 
                 // schedule
                 uint32_t schedule_index = ooo_cpu[i].ROB.next_schedule;
                 if ((ooo_cpu[i].ROB.entry[schedule_index].scheduled == 0) &&
                     (ooo_cpu[i].ROB.entry[schedule_index].event_cycle <=
                      current_core_cycle[i]))
-                    ooo_cpu[i].schedule_instruction();
+                    PROFILE_CALL(PROF_SCHEDULE,
+                                 ooo_cpu[i].schedule_instruction());
                 // execute
-                ooo_cpu[i].execute_instruction();
+                PROFILE_CALL(PROF_EXECUTE, ooo_cpu[i].execute_instruction());
 
-                ooo_cpu[i].update_rob();
+                PROFILE_CALL(PROF_UPDATE_ROB, ooo_cpu[i].update_rob());
 
                 // memory operation
-                ooo_cpu[i].schedule_memory_instruction();
+                PROFILE_CALL(PROF_LSQ,
+                             ooo_cpu[i].schedule_memory_instruction());
                 ooo_cpu[i].execute_memory_instruction();
 
-                ooo_cpu[i].update_rob();
+                PROFILE_CALL(PROF_UPDATE_ROB, ooo_cpu[i].update_rob());
 
                 // decode
                 if (ooo_cpu[i].DECODE_BUFFER.occupancy > 0) {
-                    ooo_cpu[i].decode_and_dispatch();
+                    PROFILE_CALL(PROF_DECODE, ooo_cpu[i].decode_and_dispatch());
                 }
 
                 // fetch
-                ooo_cpu[i].fetch_instruction();
+                PROFILE_CALL(PROF_FETCH, ooo_cpu[i].fetch_instruction());
 
                 // read from trace
                 if ((ooo_cpu[i].IFETCH_BUFFER.occupancy <
                      ooo_cpu[i].IFETCH_BUFFER.SIZE) &&
-                    (ooo_cpu[i].fetch_stall == 0)) {
-                    ooo_cpu[i].read_from_trace();
+                    (ooo_cpu[i].fetch_stall == 0) && !smarts.fetch_blocked()) {
+                    PROFILE_CALL(PROF_TRACE_READ,
+                                 ooo_cpu[i].read_from_trace());
                 }
             }
 
@@ -996,9 +1412,7 @@ int main(int argc, char **argv) {
                      << " cycles: " << current_core_cycle[i];
                 cout << " heartbeat IPC: " << heartbeat_ipc
                      << " cumulative IPC: " << cumulative_ipc;
-                cout << " (Simulation time: " << elapsed_hour << " hr "
-                     << elapsed_minute << " min " << elapsed_second << " sec) "
-                     << endl;
+                print_simulation_time();
                 ooo_cpu[i].next_print_instruction += STAT_PRINTING_PERIOD;
 
                 ooo_cpu[i].last_sim_instr = ooo_cpu[i].num_retired;
@@ -1014,7 +1428,7 @@ int main(int argc, char **argv) {
             // check for warmup
             // warmup complete
             if ((warmup_complete[i] == 0) &&
-                (ooo_cpu[i].num_retired > warmup_instructions)) {
+                (ooo_cpu[i].trace_position() > warmup_instructions)) {
                 warmup_complete[i] = 1;
                 all_warmup_complete++;
             }
@@ -1025,6 +1439,9 @@ int main(int argc, char **argv) {
                 finish_warmup();
             }
 
+            if (smarts.enabled && (all_warmup_complete > NUM_CPUS))
+                smarts.operate();
+
             /*
             if (all_warmup_complete == 0) {
                 all_warmup_complete = 1;
@@ -1037,8 +1454,8 @@ int main(int argc, char **argv) {
             // simulation complete
             if ((all_warmup_complete > NUM_CPUS) &&
                 (simulation_complete[i] == 0) &&
-                (ooo_cpu[i].num_retired >=
-                 (ooo_cpu[i].begin_sim_instr +
+                (ooo_cpu[i].trace_position() >=
+                 (ooo_cpu[i].begin_sim_position +
                   ooo_cpu[i].simulation_instructions))) {
                 simulation_complete[i] = 1;
                 ooo_cpu[i].finish_sim_instr =
@@ -1052,9 +1469,7 @@ int main(int argc, char **argv) {
                 cout << " cumulative IPC: "
                      << ((float)ooo_cpu[i].finish_sim_instr /
                          ooo_cpu[i].finish_sim_cycle);
-                cout << " (Simulation time: " << elapsed_hour << " hr "
-                     << elapsed_minute << " min " << elapsed_second << " sec) "
-                     << endl;
+                print_simulation_time();
 
                 record_roi_stats(i, &ooo_cpu[i].L1D);
                 record_roi_stats(i, &ooo_cpu[i].L1I);
@@ -1071,8 +1486,18 @@ int main(int argc, char **argv) {
         // TODO: should it be backward?
         uncore.DRAM.operate();
         uncore.LLC.operate();
+
+        if (current_core_cycle[0] >= sampler.next_sample_cycle)
+            sampler.sample();
     }
 
+    sampler.finish();
+    pf_event_log.close();
+
+    double wall_seconds = std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - wall_start)
+                              .count();
+
     uint64_t elapsed_second = (uint64_t)(time(NULL) - start_time),
              elapsed_minute = elapsed_second / 60,
              elapsed_hour = elapsed_minute / 60;
@@ -1145,18 +1570,31 @@ int main(int argc, char **argv) {
     cout << "Percentage of reads to DRAM that are L1D-initiated prefetches: "
          << (100.0 * l1d_prefetch_hit_at[3] / dram_reads) << endl;
 
-    cout << "At L1D number of prefetches with priority " << endl;
-    for (int c = 0; c < NUM_CPUS; c++) {
-        for (int i = 1; i < 4; i++) {
-            cout << i << " : " << ooo_cpu[c].L1D.pf_stats[i] << endl;
-        }
-    }
-
 #ifndef CRC2_COMPILE
     uncore.LLC.llc_replacement_final_stats();
     print_dram_stats();
+    print_priority_class_stats();
+    print_latency_histograms();
     print_branch_stats();
 #endif
 
+    if (smarts.enabled)
+        smarts.report();
+
+    // simulator throughput, including warmup
+    uint64_t total_retired = 0;
+    for (uint32_t i = 0; i < NUM_CPUS; i++)
+        total_retired += ooo_cpu[i].trace_position();
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    cout << endl
+         << "Simulator throughput: " << total_retired << " instructions in "
+         << wall_seconds << " sec  KIPS: "
+         << (wall_seconds > 0 ? total_retired / wall_seconds / 1000 : 0)
+         << "  Peak RSS: " << (usage.ru_maxrss >> 10) << " MB" << endl;
+
+    if (knob_profile)
+        profiler.report(wall_seconds);
+
     return 0;
 }
@@ -1,5 +1,6 @@
 #include "ooo_cpu.h"
 #include "set.h"
+#include "trace_shm.h"
 
 // out-of-order core
 O3_CPU ooo_cpu[NUM_CPUS];
@@ -8,6 +9,18 @@ uint32_t SCHEDULING_LATENCY = 0, EXEC_LATENCY = 0, DECODE_LATENCY = 0;
 
 void O3_CPU::initialize_core() {}
 
+// Start the trace over. A trace_server stream comes from fopencookie(), not
+// popen(), so it is closed with fclose() and attached to the ring again.
+void O3_CPU::reopen_trace() {
+    if (trace_shm) {
+        fclose(trace_file);
+        trace_file = trace_shm_open(trace_string, gunzip_command);
+    } else {
+        pclose(trace_file);
+        trace_file = popen(gunzip_command, "r");
+    }
+}
+
 void O3_CPU::read_from_trace() {
     // actual processors do not work like this but for easier implementation,
     // we read instruction traces and virtually add them in the ROB
@@ -30,8 +43,7 @@ void O3_CPU::read_from_trace() {
                      << " Repeating trace: " << trace_string << endl;
 
                 // close the trace file and re-open it
-                pclose(trace_file);
-                trace_file = popen(gunzip_command, "r");
+                reopen_trace();
                 if (trace_file == NULL) {
                     cerr << endl
                          << "*** CANNOT REOPEN TRACE FILE: " << trace_string
@@ -164,8 +176,7 @@ void O3_CPU::read_from_trace() {
                      << " Repeating trace: " << trace_string << endl;
 
                 // close the trace file and re-open it
-                pclose(trace_file);
-                trace_file = popen(gunzip_command, "r");
+                reopen_trace();
                 if (trace_file == NULL) {
                     cerr << endl
                          << "*** CANNOT REOPEN TRACE FILE: " << trace_string
@@ -424,6 +435,125 @@ void O3_CPU::read_from_trace() {
     // instrs_to_fetch_this_cycle = num_reads;
 }
 
+void O3_CPU::warm_data_access(ooo_model_instr &instr, uint64_t va,
+                              uint8_t type) {
+    uint64_t pa = va_to_pa(cpu, instr.instr_id, va, va >> LOG2_PAGE_SIZE, 0),
+             vpage = va >> LOG2_PAGE_SIZE;
+    if (knob_cloudsuite)
+        vpage = (vpage << 9) | instr.asid[1];
+
+    DTLB.warm_access(vpage, va, instr.ip, type, pa >> LOG2_PAGE_SIZE);
+    L1D.warm_access(pa >> LOG2_BLOCK_SIZE, pa, instr.ip, type, 0);
+}
+
+// Fast-forward for sampled simulation: consume exactly `instructions`
+// instructions from the trace without timing them. read_from_trace() keeps
+// the branch predictor, page table and L1I prefetcher trained; every new
+// instruction line and every data access then warms the TLBs and caches.
+// The rest of the last batch read stays in IFETCH_BUFFER for the detailed
+// pipeline. The pipeline past IFETCH_BUFFER must be empty. Returns the
+// number of instructions consumed.
+uint64_t O3_CPU::functional_warm(uint64_t instructions) {
+    // branch stats only describe detailed simulation
+    uint64_t saved_num_branch = num_branch,
+             saved_branch_mispredictions = branch_mispredictions,
+             saved_rob_occupancy_at_mispredict =
+                 total_rob_occupancy_at_branch_mispredict;
+    uint64_t done = 0, last_ipage = 0, last_iline = 0;
+
+    functional_warming = 1;
+    while (done < instructions) {
+        read_from_trace();
+        fetch_stall = 0;
+
+        while (IFETCH_BUFFER.occupancy && done < instructions) {
+            ooo_model_instr &instr = IFETCH_BUFFER.entry[IFETCH_BUFFER.head];
+
+            if ((instr.ip >> LOG2_PAGE_SIZE) != last_ipage) {
+                last_ipage = instr.ip >> LOG2_PAGE_SIZE;
+                ITLB.warm_access(last_ipage, instr.ip, instr.ip, LOAD,
+                                 instr.instruction_pa >> LOG2_PAGE_SIZE);
+            }
+            if ((instr.instruction_pa >> LOG2_BLOCK_SIZE) != last_iline) {
+                last_iline = instr.instruction_pa >> LOG2_BLOCK_SIZE;
+                L1I.warm_access(last_iline, instr.instruction_pa, instr.ip,
+                                LOAD, 0);
+            }
+
+            for (uint32_t i = 0; i < NUM_INSTR_SOURCES; i++)
+                if (instr.source_memory[i])
+                    warm_data_access(instr, instr.source_memory[i], LOAD);
+
+            for (uint32_t i = 0; i < MAX_INSTR_DESTINATIONS; i++) {
+                if (instr.destination_memory[i] == 0)
+                    continue;
+                warm_data_access(instr, instr.destination_memory[i], RFO);
+
+                // release the store's STA slot, as add_store_queue would
+                STA[STA_head] = UINT64_MAX;
+                STA_head++;
+                if (STA_head == STA_SIZE)
+                    STA_head = 0;
+            }
+
+            ooo_model_instr empty_entry;
+            instr = empty_entry;
+            IFETCH_BUFFER.head++;
+            if (IFETCH_BUFFER.head >= IFETCH_BUFFER.SIZE)
+                IFETCH_BUFFER.head = 0;
+            IFETCH_BUFFER.occupancy--;
+
+            num_functional++;
+            done++;
+        }
+    }
+
+    functional_warming = 0;
+
+    // page walks performed above must not stall the detailed pipeline
+    stall_cycle[cpu] = current_core_cycle[cpu];
+
+    num_branch = saved_num_branch;
+    branch_mispredictions = saved_branch_mispredictions;
+    total_rob_occupancy_at_branch_mispredict =
+        saved_rob_occupancy_at_mispredict;
+
+    return done;
+}
+
+// Seek forward in the trace by discarding `instructions` records without
+// decoding them, reopening the trace at its end as read_from_trace() does.
+// Used to start a run in the middle of a long trace (interval sharding);
+// nothing is warmed, so it must be called before the first read_from_trace().
+uint64_t O3_CPU::skip_trace(uint64_t instructions) {
+    size_t instr_size =
+        knob_cloudsuite ? sizeof(cloudsuite_instr) : sizeof(input_instr);
+    const uint64_t block = 4096;
+    vector<char> buffer(block * instr_size);
+    uint64_t done = 0;
+
+    while (done < instructions) {
+        size_t want = min(block, instructions - done),
+               got = fread(buffer.data(), instr_size, want, trace_file);
+        done += got;
+
+        if (got < want) {
+            cout << "*** Reached end of trace for Core: " << cpu
+                 << " Repeating trace: " << trace_string << endl;
+
+            reopen_trace();
+            if (trace_file == NULL) {
+                cerr << endl
+                     << "*** CANNOT REOPEN TRACE FILE: " << trace_string
+                     << " ***" << endl;
+                assert(0);
+            }
+        }
+    }
+
+    return done;
+}
+
 uint32_t O3_CPU::add_to_rob(ooo_model_instr *arch_instr) {
     uint32_t index = ROB.tail;
 
@@ -437,6 +567,21 @@ uint32_t O3_CPU::add_to_rob(ooo_model_instr *arch_instr) {
     ROB.entry[index] = *arch_instr;
     ROB.entry[index].event_cycle = current_core_cycle[cpu];
 
+    // a store becomes the youngest one to its addresses
+    for (uint32_t i = 0; i < MAX_INSTR_DESTINATIONS; i++) {
+        uint64_t address = ROB.entry[index].destination_memory[i];
+        if (address == 0)
+            continue;
+
+        uint32_t link = index * NUM_INSTR_DESTINATIONS_SPARC + i;
+        uint64_t *youngest = store_map.find(address);
+        if (youngest) {
+            ROB.entry[index].prev_store[i] = *youngest;
+            *youngest = link;
+        } else
+            store_map[address] = link;
+    }
+
     ROB.occupancy++;
     ROB.tail++;
     if (ROB.tail >= ROB.SIZE)
@@ -830,6 +975,16 @@ int O3_CPU::prefetch_code_line(uint64_t pf_v_addr) {
         assert(0);
     }
 
+    if (functional_warming) {
+        uint64_t pf_pa =
+            (va_to_pa(cpu, 0, pf_v_addr, pf_v_addr >> LOG2_PAGE_SIZE, 1) &
+             (~((1 << LOG2_PAGE_SIZE) - 1))) |
+            (pf_v_addr & ((1 << LOG2_PAGE_SIZE) - 1));
+        L1I.warm_access(pf_pa >> LOG2_BLOCK_SIZE, pf_pa, pf_v_addr, PREFETCH,
+                        0, FILL_L1);
+        return 1;
+    }
+
     L1I.pf_requested++;
 
     if (L1I.PQ.occupancy < L1I.PQ.SIZE) {
@@ -872,44 +1027,23 @@ void O3_CPU::schedule_instruction() {
         return;
 
     // execution is out-of-order but we have an in-order scheduling algorithm to
-    // detect all RAW dependencies
-    uint32_t limit = ROB.next_fetch[1];
-    num_searched = 0;
-    if (ROB.head < limit) {
-        for (uint32_t i = ROB.head; i < limit; i++) {
-            if ((ROB.entry[i].fetched != COMPLETED) ||
-                (ROB.entry[i].event_cycle > current_core_cycle[cpu]) ||
-                (num_searched >= SCHEDULER_SIZE))
-                return;
-
-            if (ROB.entry[i].scheduled == 0)
-                do_scheduling(i);
-
-            num_searched++;
-        }
-    } else {
-        for (uint32_t i = ROB.head; i < ROB.SIZE; i++) {
-            if ((ROB.entry[i].fetched != COMPLETED) ||
-                (ROB.entry[i].event_cycle > current_core_cycle[cpu]) ||
-                (num_searched >= SCHEDULER_SIZE))
-                return;
-
-            if (ROB.entry[i].scheduled == 0)
-                do_scheduling(i);
-
-            num_searched++;
-        }
-        for (uint32_t i = 0; i < limit; i++) {
-            if ((ROB.entry[i].fetched != COMPLETED) ||
-                (ROB.entry[i].event_cycle > current_core_cycle[cpu]) ||
-                (num_searched >= SCHEDULER_SIZE))
-                return;
+    // detect all RAW dependencies. Entries from ROB.head to ROB.next_schedule
+    // are scheduled already and count against SCHEDULER_SIZE, so only the
+    // entries scheduled in this cycle are visited. Scheduling does not wrap
+    // around the end of the ROB array until the head does.
+    if (ROB.next_schedule < ROB.head)
+        return;
 
-            if (ROB.entry[i].scheduled == 0)
-                do_scheduling(i);
+    num_searched = ROB.next_schedule - ROB.head;
+    for (uint32_t i = ROB.next_schedule;
+         (i < ROB.SIZE) && (num_searched < SCHEDULER_SIZE);
+         i++, num_searched++) {
+        if ((ROB.entry[i].fetched != COMPLETED) ||
+            (ROB.entry[i].event_cycle > current_core_cycle[cpu]))
+            return;
 
-            num_searched++;
-        }
+        if (ROB.entry[i].scheduled == 0)
+            do_scheduling(i);
     }
 }
 
@@ -920,9 +1054,11 @@ void O3_CPU::do_scheduling(uint32_t rob_index) {
     reg_dependency(rob_index);
     ROB.next_schedule = (rob_index == (ROB.SIZE - 1)) ? 0 : (rob_index + 1);
 
-    if (ROB.entry[rob_index].is_memory)
+    if (ROB.entry[rob_index].is_memory) {
         ROB.entry[rob_index].scheduled = INFLIGHT;
-    else {
+        if (ROB.entry[rob_index].reg_ready)
+            ready_memory[ROB.entry[rob_index].instr_id] = rob_index;
+    } else {
         ROB.entry[rob_index].scheduled = COMPLETED;
 
         // ADD LATENCY
@@ -979,78 +1115,58 @@ void O3_CPU::reg_dependency(uint32_t rob_index) {
         }
     });
 
-    // check RAW dependency
-    int prior = rob_index - 1;
-    if (prior < 0)
-        prior = ROB.SIZE - 1;
-
-    if (rob_index != ROB.head) {
-        if ((int)ROB.head <= prior) {
-            for (int i = prior; i >= (int)ROB.head; i--)
-                if (ROB.entry[i].executed != COMPLETED) {
-                    for (uint32_t j = 0; j < NUM_INSTR_SOURCES; j++) {
-                        if (ROB.entry[rob_index].source_registers[j] &&
-                            (ROB.entry[rob_index].reg_RAW_checked[j] == 0))
-                            reg_RAW_dependency(i, rob_index, j);
-                    }
-                }
-        } else {
-            for (int i = prior; i >= 0; i--)
-                if (ROB.entry[i].executed != COMPLETED) {
-                    for (uint32_t j = 0; j < NUM_INSTR_SOURCES; j++) {
-                        if (ROB.entry[rob_index].source_registers[j] &&
-                            (ROB.entry[rob_index].reg_RAW_checked[j] == 0))
-                            reg_RAW_dependency(i, rob_index, j);
-                    }
-                }
-            for (int i = ROB.SIZE - 1; i >= (int)ROB.head; i--)
-                if (ROB.entry[i].executed != COMPLETED) {
-                    for (uint32_t j = 0; j < NUM_INSTR_SOURCES; j++) {
-                        if (ROB.entry[rob_index].source_registers[j] &&
-                            (ROB.entry[rob_index].reg_RAW_checked[j] == 0))
-                            reg_RAW_dependency(i, rob_index, j);
-                    }
-                }
-        }
+    // check RAW dependency against the youngest writer of each source, if it
+    // has not completed yet. A completed youngest writer means the value is
+    // ready; the backward ROB scan this replaced went on to an older,
+    // incomplete writer of the same register and waited on it falsely.
+    for (uint32_t j = 0; j < NUM_INSTR_SOURCES; j++) {
+        uint8_t reg = ROB.entry[rob_index].source_registers[j];
+        if (reg == 0)
+            continue;
+
+        uint32_t prior = rename_rob_index[reg];
+        if ((prior < ROB.SIZE) && (ROB.entry[prior].executed != COMPLETED))
+            reg_RAW_dependency(prior, rob_index, j);
     }
-}
 
-void O3_CPU::reg_RAW_dependency(uint32_t prior, uint32_t current,
-                                uint32_t source_index) {
+    // later instructions read my destinations from me
     for (uint32_t i = 0; i < MAX_INSTR_DESTINATIONS; i++) {
-        if (ROB.entry[prior].destination_registers[i] == 0)
+        uint8_t reg = ROB.entry[rob_index].destination_registers[i];
+        if (reg == 0)
             continue;
 
-        if (ROB.entry[prior].destination_registers[i] ==
-            ROB.entry[current].source_registers[source_index]) {
-
-            // we need to mark this dependency in the ROB since the producer
-            // might not be added in the store queue yet
-            ROB.entry[prior].registers_instrs_depend_on_me.insert(
-                current); // this load cannot be executed until the prior store
-                          // gets executed
-            ROB.entry[prior].registers_index_depend_on_me[source_index].insert(
-                current); // this load cannot be executed until the prior store
-                          // gets executed
-            ROB.entry[prior].reg_RAW_producer = 1;
+        rename_rob_index[reg] = rob_index;
+    }
+}
 
-            ROB.entry[current].reg_ready = 0;
-            ROB.entry[current].producer_id = ROB.entry[prior].instr_id;
-            ROB.entry[current].num_reg_dependent++;
-            ROB.entry[current].reg_RAW_checked[source_index] = 1;
+void O3_CPU::reg_RAW_dependency(uint32_t prior, uint32_t current,
+                                uint32_t source_index) {
+    // we need to mark this dependency in the ROB since the producer might not
+    // be added in the store queue yet; append the consumer's source operand
+    // to the producer's list so the release wakes it in program order
+    uint32_t link = current * NUM_INSTR_SOURCES + source_index;
+    if (ROB.entry[prior].reg_consumer_head == UINT32_MAX)
+        ROB.entry[prior].reg_consumer_head = link;
+    else {
+        uint32_t tail = ROB.entry[prior].reg_consumer_tail;
+        ROB.entry[tail / NUM_INSTR_SOURCES]
+            .next_reg_consumer[tail % NUM_INSTR_SOURCES] = link;
+    }
+    ROB.entry[prior].reg_consumer_tail = link;
+    ROB.entry[prior].reg_RAW_producer = 1;
 
-            DP(if (warmup_complete[cpu]) {
-                cout << "[ROB] " << __func__
-                     << " instr_id: " << ROB.entry[current].instr_id
-                     << " is_memory: " << +ROB.entry[current].is_memory;
-                cout << " RAW reg_index: "
-                     << +ROB.entry[current].source_registers[source_index];
-                cout << " producer_id: " << ROB.entry[prior].instr_id << endl;
-            });
+    ROB.entry[current].reg_ready = 0;
+    ROB.entry[current].producer_id = ROB.entry[prior].instr_id;
+    ROB.entry[current].num_reg_dependent++;
 
-            return;
-        }
-    }
+    DP(if (warmup_complete[cpu]) {
+        cout << "[ROB] " << __func__
+             << " instr_id: " << ROB.entry[current].instr_id
+             << " is_memory: " << +ROB.entry[current].is_memory;
+        cout << " RAW reg_index: "
+             << +ROB.entry[current].source_registers[source_index];
+        cout << " producer_id: " << ROB.entry[prior].instr_id << endl;
+    });
 }
 
 void O3_CPU::execute_instruction() {
@@ -1142,62 +1258,22 @@ void O3_CPU::do_execution(uint32_t rob_index) {
 }
 
 void O3_CPU::schedule_memory_instruction() {
-    if ((ROB.head == ROB.tail) && ROB.occupancy == 0)
-        return;
-
-    // execution is out-of-order but we have an in-order scheduling algorithm to
-    // detect all RAW dependencies
-    uint32_t limit = ROB.next_schedule;
+    // only memory instructions whose registers are ready can get LSQ entries;
+    // they are tried oldest first, up to SCHEDULER_SIZE attempts per cycle
     num_searched = 0;
-    if (ROB.head < limit) {
-        for (uint32_t i = ROB.head; i < limit; i++) {
-
-            if (ROB.entry[i].is_memory == 0)
-                continue;
-
-            if ((ROB.entry[i].fetched != COMPLETED) ||
-                (ROB.entry[i].event_cycle > current_core_cycle[cpu]) ||
-                (num_searched >= SCHEDULER_SIZE))
-                break;
-
-            if (ROB.entry[i].is_memory && ROB.entry[i].reg_ready &&
-                (ROB.entry[i].scheduled == INFLIGHT))
-                do_memory_scheduling(i);
-        }
-    } else {
-        for (uint32_t i = ROB.head; i < ROB.SIZE; i++) {
-
-            if (ROB.entry[i].is_memory == 0)
-                continue;
-
-            if ((ROB.entry[i].fetched != COMPLETED) ||
-                (ROB.entry[i].event_cycle > current_core_cycle[cpu]) ||
-                (num_searched >= SCHEDULER_SIZE))
-                break;
-
-            if (ROB.entry[i].is_memory && ROB.entry[i].reg_ready &&
-                (ROB.entry[i].scheduled == INFLIGHT))
-                do_memory_scheduling(i);
-        }
-        for (uint32_t i = 0; i < limit; i++) {
-
-            if (ROB.entry[i].is_memory == 0)
-                continue;
-
-            if ((ROB.entry[i].fetched != COMPLETED) ||
-                (ROB.entry[i].event_cycle > current_core_cycle[cpu]) ||
-                (num_searched >= SCHEDULER_SIZE))
-                break;
-
-            if (ROB.entry[i].is_memory && ROB.entry[i].reg_ready &&
-                (ROB.entry[i].scheduled == INFLIGHT))
-                do_memory_scheduling(i);
-        }
+    for (auto it = ready_memory.begin();
+         (it != ready_memory.end()) && (num_searched < SCHEDULER_SIZE);) {
+        uint32_t rob_index = it->second;
+        do_memory_scheduling(rob_index);
+        if (ROB.entry[rob_index].scheduled == COMPLETED)
+            it = ready_memory.erase(it);
+        else
+            ++it;
     }
 }
 
 void O3_CPU::execute_memory_instruction() {
-    operate_lsq();
+    PROFILE_CALL(PROF_LSQ, operate_lsq());
     operate_cache();
 }
 
@@ -1314,95 +1390,75 @@ void O3_CPU::add_load_queue(uint32_t rob_index, uint32_t data_index) {
         current_core_cycle[cpu] + SCHEDULING_LATENCY;
     LQ.occupancy++;
 
-    // check RAW dependency
-    int prior = rob_index - 1;
-    if (prior < 0)
-        prior = ROB.SIZE - 1;
-
-    if (rob_index != ROB.head) {
-        if ((int)ROB.head <= prior) {
-            for (int i = prior; i >= (int)ROB.head; i--) {
-                if (LQ.entry[lq_index].producer_id != UINT64_MAX)
-                    break;
+    // walk the stores to this address in the ROB from the youngest one.
+    // Stores from this instruction on may already sit in the SQ; the first
+    // older store is the RAW producer, and forwarding should be done by its
+    // SQ entry.
+    uint64_t address = LQ.entry[lq_index].virtual_address,
+             load_id = LQ.entry[lq_index].instr_id, link_id = UINT64_MAX;
+    uint64_t *youngest = store_map.find(address);
+    uint32_t forwarding_index = SQ.SIZE, war_index = SQ.SIZE;
+    for (uint32_t link = youngest ? *youngest : UINT32_MAX;
+         link != UINT32_MAX;) {
+        uint32_t prior = link / NUM_INSTR_DESTINATIONS_SPARC,
+                 slot = link % NUM_INSTR_DESTINATIONS_SPARC;
+
+        // the store retired and its slot may have been reused
+        if ((ROB.entry[prior].instr_id > link_id) ||
+            (ROB.entry[prior].destination_memory[slot] != address))
+            break;
 
-                mem_RAW_dependency(i, rob_index, data_index, lq_index);
-            }
+        if (ROB.entry[prior].instr_id >= load_id) {
+            if (ROB.entry[prior].sq_index[slot] != UINT32_MAX)
+                war_index = ROB.entry[prior].sq_index[slot];
         } else {
-            for (int i = prior; i >= 0; i--) {
-                if (LQ.entry[lq_index].producer_id != UINT64_MAX)
-                    break;
-
-                mem_RAW_dependency(i, rob_index, data_index, lq_index);
-            }
-            for (int i = ROB.SIZE - 1; i >= (int)ROB.head; i--) {
-                if (LQ.entry[lq_index].producer_id != UINT64_MAX)
-                    break;
+            mem_RAW_dependency(prior, rob_index, data_index, lq_index);
 
-                mem_RAW_dependency(i, rob_index, data_index, lq_index);
-            }
+            // a store to the same address twice uses its first SQ entry
+            for (uint32_t i = 0; i < MAX_INSTR_DESTINATIONS; i++)
+                if ((ROB.entry[prior].destination_memory[i] == address) &&
+                    (ROB.entry[prior].sq_index[i] < forwarding_index))
+                    forwarding_index = ROB.entry[prior].sq_index[i];
+            break;
         }
-    }
-
-    // check
-    // 1) if store-to-load forwarding is possible
-    // 2) if there is WAR that are not correctly executed
-    uint32_t forwarding_index = SQ.SIZE;
-    for (uint32_t i = 0; i < SQ.SIZE; i++) {
 
-        // skip empty slot
-        if (SQ.entry[i].virtual_address == 0)
-            continue;
-
-        // forwarding should be done by the SQ entry that holds the same
-        // producer_id from RAW dependency check
-        if (SQ.entry[i].virtual_address ==
-            LQ.entry[lq_index]
-                .virtual_address) { // store-to-load forwarding check
-
-            // forwarding store is in the SQ
-            if ((rob_index != ROB.head) && (LQ.entry[lq_index].producer_id ==
-                                            SQ.entry[i].instr_id)) { // RAW
-                forwarding_index = i;
-                break; // should be break
-            }
+        link_id = ROB.entry[prior].instr_id;
+        link = ROB.entry[prior].prev_store[slot];
+    }
 
-            if ((LQ.entry[lq_index].producer_id == UINT64_MAX) &&
-                (LQ.entry[lq_index].instr_id <= SQ.entry[i].instr_id)) { // WAR
-                // a load is about to be added in the load queue and we found a
-                // store that is "logically later in the program order but
-                // already executed"
-                // => this is not correctly executed WAR due to out-of-order
-                // execution, this case is possible, for example 1) application
-                // is load intensive and load queue is full 2) we have loads
-                // that can't be added in the load queue 3) subsequent stores
-                // logically behind in the program order are added in the store
-                // queue first
-
-                // thanks to the store buffer, data is not written back to the
-                // memory system until retirement also due to in-order
-                // retirement, this "already executed store" cannot be retired
-                // until we finish the prior load instruction if we detect WAR
-                // when a load is added in the load queue, just let the load
-                // instruction to access the memory system no need to mark any
-                // dependency because this is actually WAR not RAW
-
-                // do not forward data from the store queue since this is WAR
-                // just read correct data from data cache
-
-                LQ.entry[lq_index].physical_address = 0;
-                LQ.entry[lq_index].translated = 0;
-                LQ.entry[lq_index].fetched = 0;
+    if ((LQ.entry[lq_index].producer_id == UINT64_MAX) &&
+        (war_index != SQ.SIZE)) { // WAR
+        // a load is about to be added in the load queue and we found a store
+        // that is "logically later in the program order but already executed"
+        // => this is not correctly executed WAR due to out-of-order execution,
+        // this case is possible, for example 1) application is load intensive
+        // and load queue is full 2) we have loads that can't be added in the
+        // load queue 3) subsequent stores logically behind in the program
+        // order are added in the store queue first
+
+        // thanks to the store buffer, data is not written back to the memory
+        // system until retirement also due to in-order retirement, this
+        // "already executed store" cannot be retired until we finish the
+        // prior load instruction if we detect WAR when a load is added in the
+        // load queue, just let the load instruction to access the memory
+        // system no need to mark any dependency because this is actually WAR
+        // not RAW
+
+        // do not forward data from the store queue since this is WAR just
+        // read correct data from data cache
+
+        LQ.entry[lq_index].physical_address = 0;
+        LQ.entry[lq_index].translated = 0;
+        LQ.entry[lq_index].fetched = 0;
 
-                DP(if (warmup_complete[cpu]) {
-                    cout << "[LQ] " << __func__
-                         << " instr_id: " << LQ.entry[lq_index].instr_id
-                         << " reset fetched: " << +LQ.entry[lq_index].fetched;
-                    cout << " to obey WAR store instr_id: "
-                         << SQ.entry[i].instr_id
-                         << " cycle: " << current_core_cycle[cpu] << endl;
-                });
-            }
-        }
+        DP(if (warmup_complete[cpu]) {
+            cout << "[LQ] " << __func__
+                 << " instr_id: " << LQ.entry[lq_index].instr_id
+                 << " reset fetched: " << +LQ.entry[lq_index].fetched;
+            cout << " to obey WAR store instr_id: "
+                 << SQ.entry[war_index].instr_id
+                 << " cycle: " << current_core_cycle[cpu] << endl;
+        });
     }
 
     if (forwarding_index != SQ.SIZE) { // we have a store-to-load forwarding
@@ -1971,56 +2027,51 @@ void O3_CPU::complete_execution(uint32_t rob_index) {
 }
 
 void O3_CPU::reg_RAW_release(uint32_t rob_index) {
-    // if (!ROB.entry[rob_index].registers_instrs_depend_on_me.empty())
-
-    ITERATE_SET(i, ROB.entry[rob_index].registers_instrs_depend_on_me,
-                ROB_SIZE) {
-        for (uint32_t j = 0; j < NUM_INSTR_SOURCES; j++) {
-            if (ROB.entry[rob_index].registers_index_depend_on_me[j].search(
-                    i)) {
-                ROB.entry[i].num_reg_dependent--;
-
-                if (ROB.entry[i].num_reg_dependent == 0) {
-                    ROB.entry[i].reg_ready = 1;
-                    if (ROB.entry[i].is_memory)
-                        ROB.entry[i].scheduled = INFLIGHT;
-                    else {
-                        ROB.entry[i].scheduled = COMPLETED;
+    for (uint32_t link = ROB.entry[rob_index].reg_consumer_head;
+         link != UINT32_MAX;) {
+        uint32_t i = link / NUM_INSTR_SOURCES, j = link % NUM_INSTR_SOURCES;
+        link = ROB.entry[i].next_reg_consumer[j];
+
+        ROB.entry[i].num_reg_dependent--;
+
+        if (ROB.entry[i].num_reg_dependent == 0) {
+            ROB.entry[i].reg_ready = 1;
+            if (ROB.entry[i].is_memory) {
+                ROB.entry[i].scheduled = INFLIGHT;
+                ready_memory[ROB.entry[i].instr_id] = i;
+            } else {
+                ROB.entry[i].scheduled = COMPLETED;
 
 #ifdef SANITY_CHECK
-                        if (RTE0[RTE0_tail] < ROB_SIZE)
-                            assert(0);
+                if (RTE0[RTE0_tail] < ROB_SIZE)
+                    assert(0);
 #endif
-                        // remember this rob_index in the Ready-To-Execute array
-                        // 0
-                        RTE0[RTE0_tail] = i;
-
-                        DP(if (warmup_complete[cpu]) {
-                            cout << "[RTE0] " << __func__
-                                 << " instr_id: " << ROB.entry[i].instr_id
-                                 << " rob_index: " << i << " is added to RTE0";
-                            cout << " head: " << RTE0_head
-                                 << " tail: " << RTE0_tail << endl;
-                        });
-
-                        RTE0_tail++;
-                        if (RTE0_tail == ROB_SIZE)
-                            RTE0_tail = 0;
-                    }
-                }
+                // remember this rob_index in the Ready-To-Execute array 0
+                RTE0[RTE0_tail] = i;
 
                 DP(if (warmup_complete[cpu]) {
-                    cout << "[ROB] " << __func__
-                         << " instr_id: " << ROB.entry[rob_index].instr_id
-                         << " releases instr_id: ";
-                    cout << ROB.entry[i].instr_id
-                         << " reg_index: " << +ROB.entry[i].source_registers[j]
-                         << " num_reg_dependent: "
-                         << ROB.entry[i].num_reg_dependent
-                         << " cycle: " << current_core_cycle[cpu] << endl;
+                    cout << "[RTE0] " << __func__
+                         << " instr_id: " << ROB.entry[i].instr_id
+                         << " rob_index: " << i << " is added to RTE0";
+                    cout << " head: " << RTE0_head << " tail: " << RTE0_tail
+                         << endl;
                 });
+
+                RTE0_tail++;
+                if (RTE0_tail == ROB_SIZE)
+                    RTE0_tail = 0;
             }
         }
+
+        DP(if (warmup_complete[cpu]) {
+            cout << "[ROB] " << __func__
+                 << " instr_id: " << ROB.entry[rob_index].instr_id
+                 << " releases instr_id: ";
+            cout << ROB.entry[i].instr_id
+                 << " reg_index: " << +ROB.entry[i].source_registers[j]
+                 << " num_reg_dependent: " << ROB.entry[i].num_reg_dependent
+                 << " cycle: " << current_core_cycle[cpu] << endl;
+        });
     }
 }
 
@@ -2033,7 +2084,7 @@ void O3_CPU::operate_cache() {
     L2C.operate();
 
     // also handle per-cycle prefetcher operation
-    l1i_prefetcher_cycle_operate();
+    PROFILE_CALL(PROF_PF_L1I, l1i_prefetcher_cycle_operate());
 }
 
 void O3_CPU::update_rob() {
@@ -2645,6 +2696,23 @@ void O3_CPU::retire_rob() {
                  << " is retired" << endl;
         });
 
+        // the slot is reused, so the rename table and store_map must stop
+        // pointing at it; older links into it are caught by the instr_id
+        // check in add_load_queue
+        for (uint32_t i = 0; i < MAX_INSTR_DESTINATIONS; i++) {
+            uint8_t reg = ROB.entry[ROB.head].destination_registers[i];
+            if (reg && (rename_rob_index[reg] == ROB.head))
+                rename_rob_index[reg] = ROB_SIZE;
+        }
+        for (uint32_t i = 0; i < MAX_INSTR_DESTINATIONS; i++) {
+            uint64_t address = ROB.entry[ROB.head].destination_memory[i];
+            uint64_t *youngest =
+                address ? store_map.find(address) : (uint64_t *)NULL;
+            if (youngest &&
+                (*youngest == ROB.head * NUM_INSTR_DESTINATIONS_SPARC + i))
+                store_map.erase(address);
+        }
+
         ooo_model_instr empty_entry;
         ROB.entry[ROB.head] = empty_entry;
 
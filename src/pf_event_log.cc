@@ -0,0 +1,113 @@
+#include "pf_event_log.h"
+
+PF_EVENT_LOG pf_event_log;
+
+// each simulator thread fills its own buffer without taking the lock
+static thread_local PF_EVENT_BUFFER *thread_buffer = NULL;
+
+void PF_EVENT_LOG::open(const char *path) {
+    file = fopen(path, "wb");
+    if (file == NULL) {
+        cerr << "[PF_EVENT_LOG] cannot open " << path << endl;
+        assert(0);
+    }
+
+    PF_EVENT_FILE_HEADER header;
+    header.magic = PF_EVENT_FILE_MAGIC;
+    header.version = PF_EVENT_FILE_VERSION;
+    header.event_size = sizeof(PF_EVENT);
+    fwrite(&header, sizeof(header), 1, file);
+
+    enabled = 1;
+    writer = std::thread(&PF_EVENT_LOG::writer_loop, this);
+}
+
+void PF_EVENT_LOG::append(uint8_t type, uint8_t level, uint32_t cpu,
+                          uint64_t address, uint8_t priority, int64_t aux) {
+    if (thread_buffer == NULL || thread_buffer->count == PF_EVENT_BUFFER_SIZE)
+        thread_buffer = swap_buffer(thread_buffer);
+
+    PF_EVENT &e = thread_buffer->event[thread_buffer->count++];
+    e.cycle = current_core_cycle[cpu < NUM_CPUS ? cpu : 0];
+    e.address = address;
+    e.aux = aux;
+    e.type = type;
+    e.level = level;
+    e.cpu = cpu;
+    e.priority = priority;
+}
+
+// hand a full buffer (if any) to the writer and return an empty one
+PF_EVENT_BUFFER *PF_EVENT_LOG::swap_buffer(PF_EVENT_BUFFER *buffer) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    PF_EVENT_BUFFER *fresh;
+    if (spare.empty()) {
+        fresh = new PF_EVENT_BUFFER;
+    } else {
+        fresh = spare.front();
+        spare.pop_front();
+    }
+
+    if (buffer) {
+        full.push_back(buffer);
+        for (uint32_t i = 0; i < owned.size(); i++)
+            if (owned[i] == buffer)
+                owned[i] = fresh;
+        has_buffers.notify_one();
+    } else
+        owned.push_back(fresh);
+
+    return fresh;
+}
+
+void PF_EVENT_LOG::writer_loop() {
+    std::unique_lock<std::mutex> guard(lock);
+    while (1) {
+        has_buffers.wait(guard, [this] { return stop || !full.empty(); });
+
+        while (!full.empty()) {
+            PF_EVENT_BUFFER *buffer = full.front();
+            full.pop_front();
+
+            guard.unlock();
+            fwrite(buffer->event, sizeof(PF_EVENT), buffer->count, file);
+            events_written += buffer->count;
+            buffer->count = 0;
+            guard.lock();
+
+            spare.push_back(buffer);
+        }
+
+        if (stop)
+            break;
+    }
+}
+
+void PF_EVENT_LOG::close() {
+    if (!enabled)
+        return;
+    enabled = 0;
+
+    // queue the partially filled buffers; producers must be quiescent here
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        for (uint32_t i = 0; i < owned.size(); i++)
+            if (owned[i]->count)
+                full.push_back(owned[i]);
+            else
+                spare.push_back(owned[i]);
+        owned.clear();
+        stop = 1;
+    }
+    has_buffers.notify_one();
+    writer.join();
+    fclose(file);
+
+    for (uint32_t i = 0; i < spare.size(); i++)
+        delete spare[i];
+    spare.clear();
+    thread_buffer = NULL;
+
+    cout << "Prefetch event log: " << events_written << " events" << endl;
+}
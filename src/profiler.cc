@@ -0,0 +1,35 @@
+#include "profiler.h"
+
+PROFILER profiler;
+
+static const char *region_names[NUM_PROF_REGIONS] = {
+    "cycle (other)",  "retire",         "update_rob",     "schedule",
+    "execute",        "lsq",            "decode",         "fetch",
+    "trace read",     "ITLB",           "DTLB",           "STLB",
+    "L1I",            "L1D",            "L2C",            "LLC",
+    "DRAM",           "L1I prefetcher", "L1D prefetcher", "L2C prefetcher",
+    "LLC prefetcher"};
+
+void PROFILER::report(double wall_seconds) {
+    cout << endl << "Simulator Profile" << endl;
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < NUM_PROF_REGIONS; i++)
+        total += ticks[i];
+    if (total == 0)
+        return;
+
+    cout << "Sampled cycles: " << sampled_cycles << " (1 in "
+         << PROFILE_SAMPLE_PERIOD << ")  ticks/cycle: "
+         << (sampled_cycles ? total / sampled_cycles : 0) << endl;
+    for (uint32_t i = 0; i < NUM_PROF_REGIONS; i++) {
+        if (calls[i] == 0)
+            continue;
+        cout << " " << left << setw(16) << region_names[i] << right
+             << " TIME: " << setw(6) << fixed << setprecision(2)
+             << (100.0 * ticks[i] / total) << "%  EST_SEC: " << setw(8)
+             << (wall_seconds * ticks[i] / total)
+             << "  TICKS/CALL: " << setw(8) << (ticks[i] / calls[i]) << endl;
+        cout.unsetf(ios_base::floatfield);
+        cout << setprecision(6);
+    }
+}
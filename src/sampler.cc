@@ -0,0 +1,138 @@
+#include "sampler.h"
+#include "ooo_cpu.h"
+#include "uncore.h"
+
+INTERVAL_SAMPLER sampler;
+
+void INTERVAL_SAMPLER::snapshot_counters() {
+    for (uint32_t i = 0; i < NUM_CPUS; i++) {
+        last_retired[i] = ooo_cpu[i].num_retired;
+        last_cycle[i] = current_core_cycle[i];
+        for (uint32_t j = 0; j < 4; j++)
+            last_pf_issued[i][j] =
+                ooo_cpu[i].L1D.pf_class_stats[PF_CLASS_ISSUED][j];
+    }
+    for (uint32_t i = 0; i < DRAM_CHANNELS; i++)
+        last_dbus_busy[i] = uncore.DRAM.dbus_busy_cycles[i];
+    last_promotions = uncore.DRAM.num_promotions;
+    last_demotions = uncore.DRAM.num_demotions;
+    last_nacks = uncore.DRAM.num_nacks;
+}
+
+void INTERVAL_SAMPLER::start(const char *path, uint64_t sample_interval) {
+    file = fopen(path, "wb");
+    if (file == NULL) {
+        cerr << "[SAMPLER] cannot open " << path << endl;
+        assert(0);
+    }
+
+    SAMPLE_FILE_HEADER header;
+    header.magic = SAMPLE_FILE_MAGIC;
+    header.version = SAMPLE_FILE_VERSION;
+    header.row_size = sizeof(SAMPLE_ROW);
+    header.num_cpus = NUM_CPUS;
+    header.dram_channels = DRAM_CHANNELS;
+    header.interval = sample_interval;
+    fwrite(&header, sizeof(header), 1, file);
+
+    interval = sample_interval;
+    next_sample_cycle = current_core_cycle[0] + interval;
+    snapshot_counters();
+    enabled = 1;
+
+    writer = std::thread(&INTERVAL_SAMPLER::writer_loop, this);
+}
+
+void INTERVAL_SAMPLER::sample() {
+    next_sample_cycle += interval;
+
+    // the ring is only full when the writer is far behind; wait for it
+    // rather than dropping rows
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        has_space.wait(guard,
+                       [this] { return head - tail < SAMPLE_RING_SIZE; });
+    }
+
+    SAMPLE_ROW &row = ring[head % SAMPLE_RING_SIZE];
+    row.cycle = current_core_cycle[0];
+
+    for (uint32_t i = 0; i < NUM_CPUS; i++) {
+        row.retired[i] = ooo_cpu[i].num_retired - last_retired[i];
+        row.cycles[i] = current_core_cycle[i] - last_cycle[i];
+        row.l1d_mshr[i] = ooo_cpu[i].L1D.MSHR.occupancy;
+        row.l2c_mshr[i] = ooo_cpu[i].L2C.MSHR.occupancy;
+        for (uint32_t j = 0; j < 4; j++)
+            row.l1d_pf_issued[i][j] =
+                ooo_cpu[i].L1D.pf_class_stats[PF_CLASS_ISSUED][j] -
+                last_pf_issued[i][j];
+    }
+    row.llc_mshr = uncore.LLC.MSHR.occupancy;
+
+    for (uint32_t i = 0; i < DRAM_CHANNELS; i++) {
+        row.dram_rq[i] = uncore.DRAM.RQ[i].occupancy;
+        row.dram_wq[i] = uncore.DRAM.WQ[i].occupancy;
+        row.dram_lower_rq[i] = uncore.DRAM.LOWER_PRIORITY_RQ[i].occupancy;
+        row.dbus_busy[i] = uncore.DRAM.dbus_busy_cycles[i] - last_dbus_busy[i];
+    }
+    row.promotions = uncore.DRAM.num_promotions - last_promotions;
+    row.demotions = uncore.DRAM.num_demotions - last_demotions;
+    row.nacks = uncore.DRAM.num_nacks - last_nacks;
+
+    snapshot_counters();
+
+    // publish in batches so the writer wakes up rarely
+    std::lock_guard<std::mutex> guard(lock);
+    head++;
+    if (head - tail >= SAMPLE_WRITE_BATCH)
+        has_rows.notify_one();
+}
+
+void INTERVAL_SAMPLER::writer_loop() {
+    std::unique_lock<std::mutex> guard(lock);
+    while (1) {
+        has_rows.wait(guard, [this] {
+            return stop || (head - tail >= SAMPLE_WRITE_BATCH);
+        });
+
+        uint64_t end = head;
+        guard.unlock();
+
+        // rows in [tail, end) are owned by the writer until tail advances
+        while (tail != end) {
+            uint64_t first = tail % SAMPLE_RING_SIZE,
+                     count = std::min(end - tail, SAMPLE_RING_SIZE - first);
+            fwrite(&ring[first], sizeof(SAMPLE_ROW), count, file);
+            rows_written += count;
+
+            guard.lock();
+            tail += count;
+            has_space.notify_one();
+            guard.unlock();
+        }
+
+        guard.lock();
+        if (stop && (head == tail))
+            break;
+    }
+}
+
+void INTERVAL_SAMPLER::finish() {
+    if (!enabled)
+        return;
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stop = 1;
+    }
+    has_rows.notify_one();
+    writer.join();
+
+    fclose(file);
+    enabled = 0;
+    next_sample_cycle = UINT64_MAX;
+
+    cout << "Interval sampler: " << rows_written << " samples of "
+         << sizeof(SAMPLE_ROW) << " bytes every " << interval << " cycles"
+         << endl;
+}
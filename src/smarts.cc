@@ -0,0 +1,150 @@
+#include <cmath>
+
+#include "smarts.h"
+#include "ooo_cpu.h"
+#include "uncore.h"
+
+SMARTS_SAMPLER smarts;
+uint8_t functional_warming = 0;
+
+double SMARTS_METRIC::interval() const {
+    if (n < 2)
+        return 0;
+    double variance = (sum_sq - sum * sum / n) / (n - 1);
+    return SMARTS_Z * sqrt(max(variance, 0.0) / n);
+}
+
+void SMARTS_SAMPLER::fast_forward_warmup(uint64_t instructions) {
+    functional_instr += ooo_cpu[0].functional_warm(instructions);
+}
+
+void SMARTS_SAMPLER::start() {
+    phase = SMARTS_WARM;
+    phase_start_instr = window_start_instr = ooo_cpu[0].num_retired;
+    phase_start_cycle = current_core_cycle[0];
+
+    cout << "SMARTS sampling period: " << period
+         << " detailed warmup: " << detailed_warmup << " window: " << window;
+    if (target_error > 0)
+        cout << " target error: " << 100 * target_error << "%";
+    cout << endl;
+}
+
+uint64_t SMARTS_SAMPLER::demand_misses(uint32_t level) {
+    CACHE *cache = level == 0   ? &ooo_cpu[0].L1D
+                   : level == 1 ? &ooo_cpu[0].L2C
+                                : &uncore.LLC;
+    return cache->sim_miss[0][LOAD] + cache->sim_miss[0][RFO];
+}
+
+uint8_t SMARTS_SAMPLER::drained() {
+    O3_CPU &core = ooo_cpu[0];
+    if (core.ROB.occupancy || core.IFETCH_BUFFER.occupancy ||
+        core.DECODE_BUFFER.occupancy || core.LQ.occupancy || core.SQ.occupancy)
+        return 0;
+
+    CACHE *caches[] = {&core.ITLB, &core.DTLB, &core.STLB, &core.L1I,
+                       &core.L1D,  &core.L2C,  &uncore.LLC};
+    for (CACHE *cache : caches)
+        if (cache->MSHR.occupancy)
+            return 0;
+
+    return 1;
+}
+
+void SMARTS_SAMPLER::record_window() {
+    O3_CPU &core = ooo_cpu[0];
+    double instr = core.num_retired - phase_start_instr,
+           cycles = current_core_cycle[0] - phase_start_cycle;
+
+    metric[SMARTS_CPI].add(cycles / instr);
+    for (uint32_t level = 0; level < 3; level++)
+        metric[SMARTS_L1D_MPKI + level].add(
+            1000.0 * (demand_misses(level) - start_miss[level]) / instr);
+    metric[SMARTS_BRANCH_MPKI].add(
+        1000.0 * (core.branch_mispredictions - start_branch_miss) / instr);
+}
+
+void SMARTS_SAMPLER::operate() {
+    O3_CPU &core = ooo_cpu[0];
+
+    switch (phase) {
+    case SMARTS_WARM:
+        if (core.num_retired - phase_start_instr < detailed_warmup)
+            break;
+
+        phase = SMARTS_MEASURE;
+        phase_start_instr = core.num_retired;
+        phase_start_cycle = current_core_cycle[0];
+        for (uint32_t level = 0; level < 3; level++)
+            start_miss[level] = demand_misses(level);
+        start_branch_miss = core.branch_mispredictions;
+        break;
+
+    case SMARTS_MEASURE:
+        if (core.num_retired - phase_start_instr < window)
+            break;
+
+        record_window();
+        phase = SMARTS_DRAIN;
+        phase_start_cycle = current_core_cycle[0];
+
+        if (target_error > 0 && metric[SMARTS_CPI].n >= SMARTS_MIN_WINDOWS &&
+            metric[SMARTS_CPI].interval() <=
+                target_error * metric[SMARTS_CPI].mean()) {
+            cout << "SMARTS target error reached after "
+                 << metric[SMARTS_CPI].n << " windows" << endl;
+            // let the main loop finish the run at the current instruction
+            core.simulation_instructions =
+                core.trace_position() - core.begin_sim_position;
+        }
+        break;
+
+    case SMARTS_DRAIN:
+        if (!drained() &&
+            current_core_cycle[0] - phase_start_cycle < SMARTS_DRAIN_LIMIT)
+            break;
+
+        uint64_t detailed = core.num_retired - window_start_instr,
+                 end = core.begin_sim_position + core.simulation_instructions,
+                 position = core.trace_position(),
+                 skip = period > detailed ? period - detailed : 0;
+        detailed_instr += detailed;
+        if (position + skip > end)
+            skip = end > position ? end - position : 0;
+        functional_instr += core.functional_warm(skip);
+
+        phase = SMARTS_WARM;
+        phase_start_instr = window_start_instr = core.num_retired;
+        break;
+    }
+}
+
+void SMARTS_SAMPLER::report() {
+    const SMARTS_METRIC &cpi = metric[SMARTS_CPI];
+    const char *names[NUM_SMARTS_METRICS] = {"CPI", "L1D MPKI", "L2C MPKI",
+                                             "LLC MPKI", "Branch MPKI"};
+
+    cout << endl
+         << "SMARTS Sampled Statistics (cache and core statistics above cover "
+            "detailed instructions only)"
+         << endl;
+    cout << "SMARTS windows: " << cpi.n << " detailed instructions: "
+         << detailed_instr + ooo_cpu[0].num_retired - window_start_instr
+         << " functional instructions: " << functional_instr << endl;
+
+    for (int i = 0; i < NUM_SMARTS_METRICS; i++) {
+        double mean = metric[i].mean(), ci = metric[i].interval();
+        cout << "SMARTS " << setw(11) << left << names[i] << right << ": "
+             << mean << " +- " << ci;
+        if (mean > 0)
+            cout << " (" << 100 * ci / mean << "%)";
+        cout << endl;
+    }
+
+    double mean = cpi.mean(), ci = cpi.interval();
+    cout << "SMARTS IPC        : " << (mean > 0 ? 1 / mean : 0) << " ["
+         << (mean + ci > 0 ? 1 / (mean + ci) : 0) << ", "
+         << (mean > ci ? 1 / (mean - ci) : 0) << "] at 99.7% confidence"
+         << endl;
+}
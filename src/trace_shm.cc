@@ -0,0 +1,142 @@
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "trace_shm.h"
+
+struct TRACE_SHM_COOKIE {
+    TRACE_SHM_HEADER *header;
+    TRACE_SHM_READER *slot;
+    char *ring;
+    uint64_t pos, map_size;
+    std::string path;
+};
+
+static uint8_t server_alive(TRACE_SHM_HEADER *header) {
+    return header->alive.load(std::memory_order_acquire) &&
+           (kill(header->server_pid, 0) == 0 || errno != ESRCH);
+}
+
+static ssize_t trace_shm_read(void *c, char *buf, size_t size) {
+    TRACE_SHM_COOKIE *cookie = (TRACE_SHM_COOKIE *)c;
+    TRACE_SHM_HEADER *header = cookie->header;
+
+    while (1) {
+        uint64_t written = header->written.load(std::memory_order_acquire);
+        if (cookie->pos < written) {
+            uint64_t offset = cookie->pos % header->ring_size,
+                     n = min((uint64_t)size,
+                             min(written - cookie->pos,
+                                 header->ring_size - offset));
+            memcpy(buf, cookie->ring + offset, n);
+            cookie->pos += n;
+            cookie->slot->pos.store(cookie->pos, std::memory_order_release);
+            return n;
+        }
+
+        if (!server_alive(header)) {
+            cerr << endl
+                 << "*** TRACE SERVER FOR " << cookie->path
+                 << " WENT AWAY ***" << endl;
+            assert(0);
+        }
+        usleep(TRACE_SHM_POLL_US);
+    }
+}
+
+// a reader the server turned away reads its own decompressor through the
+// same kind of stream, so callers close both with fclose()
+static ssize_t trace_pipe_read(void *c, char *buf, size_t size) {
+    return fread(buf, 1, size, (FILE *)c);
+}
+
+static int trace_pipe_close(void *c) { return pclose((FILE *)c); }
+
+static int trace_shm_close(void *c) {
+    TRACE_SHM_COOKIE *cookie = (TRACE_SHM_COOKIE *)c;
+    cookie->slot->state.store(TRACE_SHM_FREE, std::memory_order_release);
+    munmap(cookie->header, cookie->map_size);
+    delete cookie;
+    return 0;
+}
+
+FILE *trace_shm_open(const char *path, const char *command) {
+    std::string name = trace_shm_name(path);
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0)
+        return NULL;
+
+    TRACE_SHM_HEADER header_copy;
+    if (pread(fd, &header_copy, sizeof(header_copy), 0) !=
+            (ssize_t)sizeof(header_copy) ||
+        header_copy.magic != TRACE_SHM_MAGIC ||
+        header_copy.version != TRACE_SHM_VERSION) {
+        close(fd);
+        return NULL;
+    }
+
+    uint64_t map_size = TRACE_SHM_DATA_OFFSET + header_copy.ring_size;
+    void *map =
+        mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    TRACE_SHM_HEADER *header = (TRACE_SHM_HEADER *)map;
+    TRACE_SHM_READER *slot = NULL;
+    for (uint32_t i = 0; i < TRACE_SHM_READERS && !slot; i++) {
+        uint32_t expected = TRACE_SHM_FREE;
+        if (header->reader[i].state.compare_exchange_strong(
+                expected, TRACE_SHM_WAITING))
+            slot = &header->reader[i];
+    }
+    if (slot == NULL) {
+        cerr << "*** All " << TRACE_SHM_READERS << " reader slots of trace "
+             << path << " are taken ***" << endl;
+        assert(0);
+    }
+    slot->pid.store(getpid(), std::memory_order_release);
+
+    // the server places us at the start of a pass, or turns us away once
+    // that has left the ring
+    uint32_t state;
+    while ((state = slot->state.load(std::memory_order_acquire)) !=
+           TRACE_SHM_ACTIVE) {
+        if (state == TRACE_SHM_LATE) {
+            slot->state.store(TRACE_SHM_FREE, std::memory_order_release);
+            munmap(map, map_size);
+            cout << "Trace ring of " << path
+                 << " is past its start, decompressing locally" << endl;
+
+            FILE *pipe = popen(command, "r");
+            if (pipe == NULL)
+                return NULL;
+            cookie_io_functions_t functions = {trace_pipe_read, NULL, NULL,
+                                               trace_pipe_close};
+            return fopencookie(pipe, "r", functions);
+        }
+        if (!server_alive(header)) {
+            cerr << endl
+                 << "*** TRACE SERVER FOR " << path << " WENT AWAY ***"
+                 << endl;
+            assert(0);
+        }
+        usleep(TRACE_SHM_POLL_US);
+    }
+
+    TRACE_SHM_COOKIE *cookie = new TRACE_SHM_COOKIE;
+    cookie->header = header;
+    cookie->slot = slot;
+    cookie->ring = (char *)map + TRACE_SHM_DATA_OFFSET;
+    cookie->pos = slot->pos.load(std::memory_order_acquire);
+    cookie->map_size = map_size;
+    cookie->path = path;
+
+    cookie_io_functions_t functions = {trace_shm_read, NULL, NULL,
+                                       trace_shm_close};
+    return fopencookie(cookie, "r", functions);
+}